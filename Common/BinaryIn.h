@@ -0,0 +1,167 @@
+/**
+ * References:
+ * - https://algs4.cs.princeton.edu/code/edu/princeton/cs/algs4/BinaryIn.java.html
+ *
+ * Lives next to BinaryOut.h, include it with a relative path so that each
+ * program still compiles with a single g++ command.
+ */
+
+#ifndef BINARY_IN_H
+#define BINARY_IN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+
+/**
+ * Utility class for reading bits from an in-memory buffer.
+ * Bits are read MSB first through a 64-bit container that is refilled a whole
+ * word at a time, so bounds are only checked when the container runs low.
+ */
+class BinaryIn {
+    using byte = unsigned char;
+    using bit = bool;
+
+private:
+    const byte *data; // compressed bytes
+    size_t size; // number of bytes in data
+    size_t pos; // index of the next byte to load into the container
+    uint64_t container; // the next unread bits, left aligned
+    int n; // number of valid bits in container
+    int padBits; // zero bits appended to the container after data ran out
+
+    // load whole bytes until the container holds at least 57 bits
+    void refill() {
+        if (pos + 8 <= size) {
+            container |= loadBigEndian64(data + pos) >> n;
+            pos += (63 - n) >> 3;
+            n |= 56;
+        }
+        else {
+            refillTail();
+        }
+    }
+
+    // byte by byte refill near the end of data, padding with 0 past the end
+    void refillTail() {
+        if (overrun()) throw std::runtime_error("File reached EOF already!");
+
+        while (n <= 56) {
+            uint64_t x = 0;
+            if (pos < size) x = data[pos++];
+            else padBits += 8;
+            container |= x << (56 - n);
+            n += 8;
+        }
+    }
+
+    static uint64_t loadBigEndian64(const byte *p) {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        return __builtin_bswap64(word);
+#else
+        uint64_t word = 0;
+        for (int i = 0; i < 8; i++)
+            word = (word << 8) | p[i];
+        return word;
+#endif
+    }
+
+public:
+    BinaryIn(const byte *data, size_t size) :
+        data(data), size(size), pos(0), container(0), n(0), padBits(0) {}
+
+    BinaryIn() : BinaryIn(nullptr, 0) {}
+
+    /**
+     * Return the next nbits bits without consuming them.
+     * nbits must be in [1, 57]. Bits past the end of data read as 0.
+     */
+    uint64_t peek(int nbits) {
+        if (n < nbits) refill();
+        return container >> (64 - nbits);
+    }
+
+    /** Drop nbits bits, which must have been made available by peek(). */
+    void consume(int nbits) {
+        container <<= nbits;
+        n -= nbits;
+    }
+
+    /**
+     * Number of bits that can still be consumed while calling
+     * refillUnchecked() before each peek, without loading past the end of data.
+     * NOTE: refillUnchecked() loads 8 bytes from up to 8 bytes past the
+     * consumed position, so the last 16 bytes are left to the checked path.
+     */
+    uint64_t bitsBeforeTail() const {
+        uint64_t consumed = (uint64_t) pos * 8 + padBits - n;
+        uint64_t limit = size >= 16 ? (uint64_t) (size - 16) * 8 : 0;
+        return consumed < limit ? limit - consumed : 0;
+    }
+
+    /** Make at least 56 bits available, see bitsBeforeTail() for when it's safe */
+    void refillUnchecked() {
+        container |= loadBigEndian64(data + pos) >> n;
+        pos += (63 - n) >> 3;
+        n |= 56;
+    }
+
+    /** peek() after refillUnchecked(), nbits must be in [1, 56] */
+    uint64_t peekUnchecked(int nbits) const {
+        return container >> (64 - nbits);
+    }
+
+    // number of bits left in data, including the ones in the container
+    uint64_t bitsLeft() const {
+        uint64_t consumed = (uint64_t) pos * 8 + padBits - n;
+        return (uint64_t) size * 8 > consumed ? (uint64_t) size * 8 - consumed : 0;
+    }
+
+    // skip the padding up to the next byte boundary
+    void alignToByte() {
+        consume(n & 7);
+    }
+
+    // the next unread byte, only valid at a byte boundary
+    const byte* position() const {
+        return data + ((uint64_t) pos * 8 + padBits - n) / 8;
+    }
+
+    uint64_t readBits(int nbits) {
+        uint64_t x = peek(nbits);
+        consume(nbits);
+        return x;
+    }
+
+    // returns true if more bits were consumed than data holds
+    bool overrun() const {
+        return padBits > n;
+    }
+
+    // read 1 bit and return a bool (NOTE it's not 1 byte bool)
+    bool readOneBitBool() {
+        return readBits(1) == 1;
+    }
+
+    // read 1 byte and return a char
+    char readChar() {
+        return (char) readBits(8);
+    }
+
+    // read 4 bytes and return an unsigned int, see BinaryOut::writeUnsignedInt()
+    unsigned int readUnsignedInt() {
+        return (unsigned int) readBits(32);
+    }
+
+    // read 8 bytes, see BinaryOut::writeUnsignedLong()
+    uint64_t readUnsignedLong() {
+        uint64_t high = readBits(32);
+        return (high << 32) | readBits(32);
+    }
+};
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * References:
+ * - https://algs4.cs.princeton.edu/code/edu/princeton/cs/algs4/BinaryOut.java.html
+ *
+ * Shared by compress.cpp and decompress.cpp, include it with a relative path
+ * so that each program still compiles with a single g++ command.
+ */
+
+#ifndef BINARY_OUT_H
+#define BINARY_OUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+
+/**
+ * Utility class for writing bits to a preallocated output buffer.
+ * Bits are accumulated MSB first in a 64-bit register and every full 32-bit
+ * word is stored to the buffer at once. The caller sizes the buffer exactly,
+ * see OutputFile.h, so nothing has to be flushed along the way.
+ */
+class BinaryOut {
+    using byte = unsigned char;
+
+    // technically bool is still 8-bit, but let's just use it like 1 bit
+    // where true is 1, false is 0
+    using bit = bool;
+
+private:
+    uint64_t acc; // bit accumulator, the low n bits are pending output
+    int n; // number of pending bits in acc, always < 32 between calls
+    byte *buffer; // output buffer
+    size_t capacity; // size of buffer in bytes
+    size_t pos; // number of bytes used in buffer
+
+    void putWord(uint32_t x) {
+        if (pos + 4 > capacity) throw std::runtime_error("Output buffer is full!");
+
+        // store big endian, s.t. the bit stream stays MSB first
+        buffer[pos + 0] = (byte) (x >> 24);
+        buffer[pos + 1] = (byte) (x >> 16);
+        buffer[pos + 2] = (byte) (x >> 8);
+        buffer[pos + 3] = (byte) (x >> 0);
+        pos += 4;
+    }
+
+public:
+    BinaryOut(byte *buffer, size_t capacity) :
+        acc(0), n(0), buffer(buffer), capacity(capacity), pos(0) {}
+
+    /**
+     * Write the low nbits bits of value, MSB first.
+     * nbits must be in [0, 32] and value must not have bits set above nbits.
+     */
+    void writeBits(uint64_t value, int nbits) {
+        acc = (acc << nbits) | value;
+        n += nbits;
+        if (n >= 32) {
+            n -= 32;
+            putWord((uint32_t) (acc >> n));
+        }
+    }
+
+    void writeBit(bit x) {
+        writeBits(x ? 1 : 0, 1);
+    }
+
+    void writeByte(byte x) {
+        writeBits(x, 8);
+    }
+
+    void writeUnsignedInt(unsigned int x) {
+        writeBits(x, 32);
+    }
+
+    void writeUnsignedLong(uint64_t x) {
+        writeBits(x >> 32, 32);
+        writeBits(x & 0xffffffff, 32);
+    }
+
+    // pad with 0 up to a byte boundary, pos always counts whole bytes
+    void alignToByte() {
+        writeBits(0, -n & 7);
+    }
+
+    /** Copy size bytes as is, the output must be at a byte boundary */
+    void writeBytes(const byte *p, size_t size) {
+        close(); // only flushes the pending bytes at a byte boundary
+        if (pos + size > capacity) throw std::runtime_error("Output buffer is full!");
+        std::memcpy(buffer + pos, p, size);
+        pos += size;
+    }
+
+    // number of bytes written so far, counting a partial byte
+    size_t size() const {
+        return pos + (n + 7) / 8;
+    }
+
+    void close() {
+        // write out pending bits, padding with 0 from right up to a byte boundary
+        if (n > 0) {
+            int nbytes = (n + 7) / 8;
+            if (pos + nbytes > capacity) throw std::runtime_error("Output buffer is full!");
+            uint64_t padded = acc << (nbytes * 8 - n);
+            for (int i = nbytes - 1; i >= 0; i--)
+                buffer[pos++] = (byte) (padded >> (i * 8));
+            n = 0;
+            acc = 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * References:
+ * - https://www.rfc-editor.org/rfc/rfc3720#appendix-B.4
+ *
+ * CRC32C (Castagnoli) of every block, stored by compress.cpp and verified by
+ * decompress.cpp while the block is still in cache.
+ * SSE4.2 has an instruction for it, 8 bytes at a time. Other CPUs use
+ * slicing-by-8: 8 tables, s.t. 8 bytes are folded in with 8 independent
+ * lookups instead of a chain of 8 dependent ones.
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHECKSUM_SSE42
+#include <immintrin.h>
+#endif
+
+
+const uint32_t CRC32C_POLY = 0x82f63b78; // bit reversed Castagnoli polynomial
+
+/** table[k][b] is the CRC of byte b followed by k zero bytes */
+struct Crc32cTables {
+    uint32_t table[8][256];
+
+    Crc32cTables() {
+        for (int b = 0; b < 256; b++) {
+            uint32_t crc = (uint32_t) b;
+            for (int i = 0; i < 8; i++)
+                crc = (crc >> 1) ^ (CRC32C_POLY & (0 - (crc & 1)));
+            table[0][b] = crc;
+        }
+        for (int k = 1; k < 8; k++)
+            for (int b = 0; b < 256; b++)
+                table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+    }
+};
+
+inline uint32_t crc32cPortable(uint32_t crc, const unsigned char *p, size_t size) {
+    static const Crc32cTables tables;
+    const uint32_t (*t)[256] = tables.table;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint32_t lo = crc ^ ((uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+        uint32_t hi = (uint32_t) p[4] | (uint32_t) p[5] << 8 | (uint32_t) p[6] << 16 | (uint32_t) p[7] << 24;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    }
+    for (; size > 0; p++, size--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+    return crc;
+}
+
+#ifdef CHECKSUM_SSE42
+__attribute__((target("sse4.2")))
+inline uint32_t crc32cSSE42(uint32_t crc, const unsigned char *p, size_t size) {
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t) crc64;
+#endif
+    for (; size >= 4; p += 4, size -= 4) {
+        uint32_t word;
+        std::memcpy(&word, p, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; size > 0; p++, size--)
+        crc = _mm_crc32_u8(crc, *p);
+    return crc;
+}
+
+inline bool hasSSE42() {
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+}
+#endif
+
+/** CRC32C of the size bytes at data */
+inline uint32_t crc32c(const unsigned char *data, size_t size) {
+    uint32_t crc = 0xffffffff;
+#ifdef CHECKSUM_SSE42
+    if (hasSSE42())
+        crc = crc32cSSE42(crc, data, size);
+    else
+#endif
+        crc = crc32cPortable(crc, data, size);
+    return ~crc;
+}
+
+#endif
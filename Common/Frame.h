@@ -0,0 +1,208 @@
+/**
+ * Layout of the compressed file, shared by compress.cpp and decompress.cpp.
+ * The input is split into blocks of at most blockSize bytes and each block
+ * gets a Huffman code of its own, s.t. regions with very different statistics
+ * (headers, fuse maps, zero padding) don't share one compromise code.
+ * compress.cpp picks where blocks end, so every block stores its length.
+ *
+ * File:  [magic: 32 bits] [version: 8 bits] [codec ID: 8 bits] [flags: 8 bits]
+ *        [original size: varint] [block size: varint]
+ *        [static table ID: 32 bits, if FRAME_STATIC_TABLE is set]
+ *        [block]... [seek index, if FRAME_SEEK_INDEX is set]
+ * Block: [checksum: 32 bits] [block type: 8 bits] [length: varint] [content]
+ * The magic tells compressed files apart from anything else. A decoder
+ * rejects other versions, an unknown codec ID (the entropy coder of the
+ * coded blocks, only Huffman so far) and flags it doesn't know, instead of
+ * misreading them.
+ * Every block starts on a byte boundary. The checksum is the CRC32C of the
+ * original bytes of the block, see Checksum.h. The block type picks the
+ * codec of the block from a table in each tool, indexed once per block.
+ * The content depends on the type:
+ * - HUFFMAN_BLOCK: [code lengths, see writeCodeLengths()] [stream sizes] [0 padding] [stream]...
+ * - STORED_BLOCK: the original bytes as is, for data that Huffman coding
+ *   would only make larger (random patterns, scrambled fuse data).
+ * - RLE_BLOCK: runs of [byte: 8 bits] [run length: varint] that add up to the
+ *   block length, for all 0x00 / 0xFF pages and other long runs. A constant
+ *   block is a single run.
+ * - STATIC_BLOCK: same as HUFFMAN_BLOCK without the code lengths, it's coded
+ *   with the pretrained code whose ID is in the frame header, see StaticTable.h.
+ * - REPEAT_BLOCK: same as HUFFMAN_BLOCK without the code lengths, it's coded
+ *   with the code of the last HUFFMAN_BLOCK before it.
+ *
+ * A block of at least MIN_STREAMS_LENGTH bytes is cut into NUM_STREAMS
+ * segments, whose Huffman codes are written to separate byte aligned streams.
+ * The byte size of each stream but the last is stored (32 bits each), s.t.
+ * the decoder can run one bit reader per stream and interleave them: the
+ * streams don't depend on each other, so their decoding overlaps in the CPU.
+ * Shorter blocks have a single stream and no sizes.
+ *
+ * The optional seek index at the end of the file records where each block
+ * starts in the compressed and in the original file, s.t. a byte range can
+ * be decompressed without decoding the blocks before it:
+ * Index: [compressed offset: 64 bits] [original offset: 64 bits]... [number of blocks: 64 bits]
+ *
+ * A varint holds 7 bits per byte, low bits first, and the high bit of each
+ * byte is set if more bytes follow, so sizes take 64 bits only when needed.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "BinaryIn.h"
+#include "BinaryOut.h"
+
+
+const size_t MIN_BLOCK_SIZE = (size_t) 64 << 10;
+const size_t MAX_BLOCK_SIZE = (size_t) 4 << 20;
+const size_t DEFAULT_BLOCK_SIZE = (size_t) 256 << 10; // input + tables of a block stay in L2
+
+const int MAX_VARINT_BYTES = 10; // enough for 64 bits
+const int MAX_FRAME_HEADER_BYTES = 7 + 2 * MAX_VARINT_BYTES + 4;
+
+const uint32_t FRAME_MAGIC = 0x48554646; // "HUFF"
+const int FRAME_VERSION = 2; // 2: blocks store their length
+
+enum Codec { CODEC_HUFFMAN = 0 };
+
+const int FRAME_SEEK_INDEX = 1; // flag: the file ends with a seek index
+const int FRAME_STATIC_TABLE = 2; // flag: blocks may use a pretrained code
+const int FRAME_KNOWN_FLAGS = FRAME_SEEK_INDEX | FRAME_STATIC_TABLE;
+
+const int SEEK_ENTRY_BITS = 128;
+
+const int NUM_STREAMS = 4;
+const size_t MIN_STREAMS_LENGTH = 1024; // shorter blocks are a single stream
+const int STREAM_SIZE_BITS = 32;
+const int CHECKSUM_BITS = 32;
+
+enum BlockType { HUFFMAN_BLOCK = 0, STORED_BLOCK = 1, RLE_BLOCK = 2, STATIC_BLOCK = 3, REPEAT_BLOCK = 4,
+                 NUM_BLOCK_TYPES };
+
+const int BLOCK_TYPE_BITS = 8;
+
+
+struct FrameHeader {
+    int codec; // see Codec
+    size_t size; // number of bytes of the original file
+    size_t blockSize; // max number of bytes in a block
+    int flags;
+    uint32_t tableId; // ID of the static table if FRAME_STATIC_TABLE is set
+};
+
+/** Where a block starts, see the seek index above */
+struct SeekEntry {
+    size_t compressedOffset; // in the compressed file
+    size_t offset; // in the original file
+};
+
+inline int blockStreams(size_t length) {
+    return length >= MIN_STREAMS_LENGTH ? NUM_STREAMS : 1;
+}
+
+// number of bytes of the block in each stream but the last, which may be shorter
+inline size_t streamLength(size_t length, int streams) {
+    return (length + streams - 1) / streams;
+}
+
+inline void writeVarint(uint64_t x, BinaryOut &out) {
+    while (x >= 0x80) {
+        out.writeByte((unsigned char) (x | 0x80));
+        x >>= 7;
+    }
+    out.writeByte((unsigned char) x);
+}
+
+inline uint64_t readVarint(BinaryIn &in) {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 7 * MAX_VARINT_BYTES; shift += 7) {
+        uint64_t b = in.readBits(8);
+        if (shift == 63 && b > 1) break; // more than 64 bits
+        x |= (b & 0x7f) << shift;
+        if (b < 0x80) return x;
+    }
+    throw std::runtime_error("Invalid varint!");
+}
+
+inline void writeFrameHeader(const FrameHeader &header, BinaryOut &out) {
+    out.writeUnsignedInt(FRAME_MAGIC);
+    out.writeByte(FRAME_VERSION);
+    out.writeByte((unsigned char) header.codec);
+    out.writeByte((unsigned char) header.flags);
+    writeVarint(header.size, out);
+    writeVarint(header.blockSize, out);
+    if (header.flags & FRAME_STATIC_TABLE) out.writeUnsignedInt(header.tableId);
+}
+
+inline FrameHeader readFrameHeader(BinaryIn &in) {
+    FrameHeader header;
+    uint32_t magic = in.readUnsignedInt();
+    int version = (unsigned char) in.readChar();
+    header.codec = (unsigned char) in.readChar();
+    header.flags = (unsigned char) in.readChar();
+    if (in.overrun() || magic != FRAME_MAGIC) throw std::runtime_error("Not a compressed file!");
+    if (version != FRAME_VERSION) throw std::runtime_error("Unsupported format version!");
+    if (header.codec != CODEC_HUFFMAN) throw std::runtime_error("Unsupported codec!");
+    if (header.flags & ~FRAME_KNOWN_FLAGS) throw std::runtime_error("Unsupported flags!");
+
+    uint64_t size = readVarint(in);
+    uint64_t blockSize = readVarint(in);
+    header.tableId = (header.flags & FRAME_STATIC_TABLE) ? in.readUnsignedInt() : 0;
+    if (in.overrun()) throw std::runtime_error("File reached EOF already!");
+    if (blockSize < MIN_BLOCK_SIZE || blockSize > MAX_BLOCK_SIZE)
+        throw std::runtime_error("Invalid block size!");
+    if (size > SIZE_MAX - blockSize) throw std::runtime_error("File is too large!");
+    header.size = (size_t) size;
+    header.blockSize = (size_t) blockSize;
+    return header;
+}
+
+inline size_t seekIndexBytes(size_t blocks) {
+    return (blocks * SEEK_ENTRY_BITS + 64) / 8;
+}
+
+inline void writeSeekIndex(const std::vector<SeekEntry> &index, BinaryOut &out) {
+    for (const SeekEntry &e : index) {
+        out.writeUnsignedLong(e.compressedOffset);
+        out.writeUnsignedLong(e.offset);
+    }
+    out.writeUnsignedLong(index.size());
+}
+
+/**
+ * Read the seek index at the end of the size bytes of data, the first block
+ * starts at blocksBegin.
+ */
+inline std::vector<SeekEntry> readSeekIndex(const unsigned char *data, size_t size, size_t blocksBegin,
+                                            const FrameHeader &header) {
+    if (size - blocksBegin < seekIndexBytes(0)) throw std::runtime_error("Invalid seek index!");
+    BinaryIn count(data + size - seekIndexBytes(0), seekIndexBytes(0));
+    uint64_t blocks = count.readUnsignedLong();
+    if (blocks > (size - blocksBegin) / (SEEK_ENTRY_BITS / 8)) throw std::runtime_error("Invalid seek index!");
+    size_t indexBytes = seekIndexBytes((size_t) blocks);
+    if (indexBytes > size - blocksBegin) throw std::runtime_error("Invalid seek index!");
+
+    // blocks follow each other, are at most blockSize bytes long and cover the whole file
+    BinaryIn in(data + size - indexBytes, indexBytes);
+    std::vector<SeekEntry> index((size_t) blocks);
+    for (size_t b = 0; b < blocks; b++) {
+        uint64_t compressedOffset = in.readUnsignedLong();
+        uint64_t offset = in.readUnsignedLong();
+        bool valid = b == 0 ? offset == 0 && compressedOffset == blocksBegin
+                            : offset > index[b - 1].offset && offset - index[b - 1].offset <= header.blockSize &&
+                              compressedOffset > index[b - 1].compressedOffset;
+        if (!valid || offset >= header.size || compressedOffset > size - indexBytes)
+            throw std::runtime_error("Invalid seek index!");
+        index[b] = { (size_t) compressedOffset, (size_t) offset };
+    }
+    if ((blocks == 0) != (header.size == 0) ||
+        (blocks > 0 && header.size - index[blocks - 1].offset > header.blockSize))
+        throw std::runtime_error("Invalid seek index!");
+    return index;
+}
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * References:
+ * - https://fastcompression.blogspot.com/2014/09/counting-bytes-fast-little-trick-from.html
+ *
+ * Byte frequency counting for the Huffman code.
+ * A single table of counters stalls on long runs of the same byte, since
+ * every increment has to wait for the previous store to the same counter.
+ * Spreading consecutive bytes over interleaved tables breaks that chain.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HISTOGRAM_AVX2
+#include <immintrin.h>
+#endif
+
+
+const int HISTOGRAM_TABLES = 4; // interleaved counter tables
+const size_t HISTOGRAM_CHUNK = (size_t) 1 << 30; // bytes per pass, s.t. 32-bit counters can't overflow
+
+
+/** Count 16 bytes at p, 4 bytes into each table */
+inline void countChars16(const unsigned char *p, uint32_t counts[HISTOGRAM_TABLES][256]) {
+    uint32_t w[4];
+    std::memcpy(w, p, sizeof(w));
+    for (int k = 0; k < 4; k++) {
+        counts[0][(w[k] >> 0) & 0xff]++;
+        counts[1][(w[k] >> 8) & 0xff]++;
+        counts[2][(w[k] >> 16) & 0xff]++;
+        counts[3][(w[k] >> 24) & 0xff]++;
+    }
+}
+
+inline void countCharsPortable(const unsigned char *data, size_t size, uint32_t counts[HISTOGRAM_TABLES][256]) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+        countChars16(data + i, counts);
+    for (; i < size; i++)
+        counts[0][data[i]]++;
+}
+
+#ifdef HISTOGRAM_AVX2
+const int AVX2_MAX_SCATTER = 8; // max bytes counted one by one in a block of 32
+
+/**
+ * Same as countCharsPortable(), except for blocks of 32 bytes that are mostly
+ * the same byte (the 0x00 and 0xFF regions and sparse fuse maps of repair
+ * dumps): the bytes equal to the first one are counted with a popcount and
+ * only the few others are counted one by one.
+ */
+__attribute__((target("avx2,popcnt,bmi")))
+inline void countCharsAVX2(const unsigned char *data, size_t size, uint32_t counts[HISTOGRAM_TABLES][256]) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i first = _mm256_set1_epi8((char) data[i]);
+        uint32_t diff = ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, first));
+        int scatter = __builtin_popcount(diff);
+        if (scatter <= AVX2_MAX_SCATTER) {
+            counts[0][data[i]] += 32 - scatter;
+            // spread the others over the remaining tables
+            for (int t = 1; diff != 0; t = (t == HISTOGRAM_TABLES - 1) ? 1 : t + 1) {
+                counts[t][data[i + __builtin_ctz(diff)]]++;
+                diff &= diff - 1;
+            }
+        }
+        else {
+            countChars16(data + i, counts);
+            countChars16(data + i + 16, counts);
+        }
+    }
+    for (; i < size; i++)
+        counts[0][data[i]]++;
+}
+
+inline bool hasAVX2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+/** Add the number of occurrences of each byte in data to freq */
+inline void countChars(const unsigned char *data, size_t size, uint64_t freq[256]) {
+    uint32_t counts[HISTOGRAM_TABLES][256];
+    while (size > 0) {
+        size_t chunk = size < HISTOGRAM_CHUNK ? size : HISTOGRAM_CHUNK;
+        std::memset(counts, 0, sizeof(counts));
+#ifdef HISTOGRAM_AVX2
+        if (hasAVX2())
+            countCharsAVX2(data, chunk, counts);
+        else
+#endif
+            countCharsPortable(data, chunk, counts);
+
+        for (int c = 0; c < 256; c++)
+            for (int t = 0; t < HISTOGRAM_TABLES; t++)
+                freq[c] += counts[t][c];
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+#endif
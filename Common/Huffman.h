@@ -0,0 +1,372 @@
+/**
+ * References:
+ * - https://en.wikipedia.org/wiki/Canonical_Huffman_code
+ *
+ * Canonical Huffman codes shared by compress.cpp and decompress.cpp.
+ * Only the code length of each char is stored in the compressed file, both
+ * sides derive the same codes from the lengths.
+ */
+
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include "BinaryIn.h"
+#include "BinaryOut.h"
+
+
+const int NUM_CHARS = 256;
+const int MAX_CODE_LENGTH = 15; // limit enforced by the encoder, see packageMerge()
+const int LENGTH_BITS = 4; // code lengths are stored in 4 bits
+
+
+/** Huffman code of one char, packed in the low `length` bits of code */
+struct Codeword {
+    uint32_t code;
+    uint8_t length;
+};
+
+
+/**
+ * Assign canonical codes: shorter codes first, chars of the same length in
+ * increasing order, each code is the previous one plus 1 (shifted left when
+ * the length grows). Chars with length 0 are unused.
+ * A lone used char gets the empty code, so it costs no bits at all.
+ */
+inline void buildCanonicalCodes(const uint8_t lengths[NUM_CHARS], Codeword codes[NUM_CHARS]) {
+    int count[MAX_CODE_LENGTH + 1] = {};
+    int used = 0;
+    for (int c = 0; c < NUM_CHARS; c++) {
+        count[lengths[c]]++;
+        if (lengths[c] != 0) used++;
+    }
+
+    // first code of each length
+    count[0] = 0;
+    uint32_t next[MAX_CODE_LENGTH + 1] = {};
+    uint32_t code = 0;
+    for (int len = 1; len <= MAX_CODE_LENGTH; len++) {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+
+    for (int c = 0; c < NUM_CHARS; c++) {
+        codes[c] = { 0, 0 };
+        if (lengths[c] == 0 || used == 1) continue;
+        codes[c] = { next[lengths[c]]++, lengths[c] };
+    }
+}
+
+/**
+ * Throw if the lengths don't describe a complete prefix code, i.e. the
+ * Kraft sum is not exactly 1.
+ * NOTE: a code needs at least 2 used chars, a block of a single char is an
+ * RLE_BLOCK, see compress.cpp.
+ */
+inline void checkCodeLengths(const uint8_t lengths[NUM_CHARS]) {
+    const uint32_t one = (uint32_t) 1 << MAX_CODE_LENGTH;
+    uint32_t kraft = 0;
+    int used = 0;
+    for (int c = 0; c < NUM_CHARS; c++) {
+        if (lengths[c] == 0) continue;
+        if (lengths[c] > MAX_CODE_LENGTH) throw std::runtime_error("Invalid code lengths!");
+        used++;
+        kraft += one >> lengths[c];
+        if (kraft > one) throw std::runtime_error("Invalid code lengths!");
+    }
+    if (used < 2 || kraft != one) throw std::runtime_error("Invalid code lengths!");
+}
+
+/**
+ * References:
+ * - Moffat and Katajainen, In-place calculation of minimum-redundancy codes
+ *
+ * Huffman code lengths of the n weights in A, sorted in increasing order,
+ * computed in place without any allocation. On return A[i] holds the code
+ * length of the i-th weight (non-increasing in i). n must be at least 2.
+ * The first pass merges like Huffman's algorithm, keeping the internal nodes
+ * in A in creation order and replacing each merged one by its parent index,
+ * the second pass turns parent indices into internal node depths and the
+ * third pass hands out leaf depths level by level.
+ */
+inline void moffatKatajainen(uint64_t A[], int n) {
+    int root = 0, leaf = 2, next;
+    A[0] += A[1];
+    for (next = 1; next < n - 1; next++) {
+        // select the first item of the pair
+        if (leaf >= n || A[root] < A[leaf]) {
+            A[next] = A[root];
+            A[root++] = next;
+        }
+        else {
+            A[next] = A[leaf++];
+        }
+        // add on the second item
+        if (leaf >= n || (root < next && A[root] < A[leaf])) {
+            A[next] += A[root];
+            A[root++] = next;
+        }
+        else {
+            A[next] += A[leaf++];
+        }
+    }
+
+    A[n - 2] = 0;
+    for (next = n - 3; next >= 0; next--)
+        A[next] = A[A[next]] + 1;
+
+    int available = 1, used = 0;
+    uint64_t depth = 0;
+    root = n - 2;
+    next = n - 1;
+    while (available > 0) {
+        while (root >= 0 && A[root] == depth) {
+            used++;
+            root--;
+        }
+        while (available > used) {
+            A[next--] = depth;
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+        used = 0;
+    }
+}
+
+/**
+ * References:
+ * - Larmore and Hirschberg, A fast algorithm for optimal length-limited Huffman codes
+ *
+ * Optimal code lengths of at most maxLength bits with package-merge, where
+ * 2^maxLength >= number of used chars.
+ * Level 0 lists the used chars by increasing freq, every next level merges
+ * them with the pairs ("packages") of the level before. Taking the 2n - 2
+ * cheapest items of the last level, a char's code length is the number of
+ * levels where it is selected, either directly or inside a selected package.
+ * Since chars are sorted, the selected leaves of a level are always its
+ * cheapest chars, so only a leaf/package flag per item has to be kept.
+ */
+inline void packageMerge(const uint64_t freq[NUM_CHARS], int maxLength, uint8_t lengths[NUM_CHARS]) {
+    int chars[NUM_CHARS];
+    int n = 0;
+    for (int c = 0; c < NUM_CHARS; c++) {
+        lengths[c] = 0;
+        if (freq[c] > 0) chars[n++] = c;
+    }
+    if (n == 0) return;
+    if (n == 1) {
+        lengths[chars[0]] = 1;
+        return;
+    }
+    std::sort(chars, chars + n, [&](int a, int b) {
+        return freq[a] != freq[b] ? freq[a] < freq[b] : a < b;
+    });
+
+    uint64_t weight[2][2 * NUM_CHARS]; // item weights of the previous and current level
+    bool isLeaf[MAX_CODE_LENGTH][2 * NUM_CHARS];
+    int size[MAX_CODE_LENGTH];
+
+    for (int i = 0; i < n; i++) {
+        weight[0][i] = freq[chars[i]];
+        isLeaf[0][i] = true;
+    }
+    size[0] = n;
+
+    for (int level = 1; level < maxLength; level++) {
+        const uint64_t *prev = weight[(level - 1) & 1];
+        uint64_t *cur = weight[level & 1];
+        int packages = size[level - 1] / 2;
+        int leaf = 0, pkg = 0, k = 0;
+        while (leaf < n || pkg < packages) {
+            uint64_t pkgWeight = pkg < packages ? prev[2 * pkg] + prev[2 * pkg + 1] : 0;
+            // a leaf goes first on ties
+            if (pkg == packages || (leaf < n && freq[chars[leaf]] <= pkgWeight)) {
+                cur[k] = freq[chars[leaf++]];
+                isLeaf[level][k++] = true;
+            }
+            else {
+                cur[k] = pkgWeight;
+                isLeaf[level][k++] = false;
+                pkg++;
+            }
+        }
+        size[level] = k;
+    }
+
+    int selected = 2 * n - 2;
+    for (int level = maxLength - 1; level >= 0; level--) {
+        int leaves = 0;
+        for (int k = 0; k < selected; k++)
+            if (isLeaf[level][k]) leaves++;
+        for (int i = 0; i < leaves; i++)
+            lengths[chars[i]]++;
+        selected = 2 * (selected - leaves);
+    }
+}
+
+/**
+ * Code lengths for the given char frequencies, at most maxLength bits long.
+ * Plain Huffman is optimal whenever it fits in the limit, which is the usual
+ * case, otherwise fall back to package-merge. Nothing is allocated, so it's
+ * cheap enough to run for every block of a file.
+ * A lone used char gets length 1, unused chars get 0.
+ */
+inline void buildCodeLengths(const uint64_t freq[NUM_CHARS], int maxLength, uint8_t lengths[NUM_CHARS]) {
+    // sort (freq, char) pairs packed in one integer, freq is far below 2^56
+    uint64_t keys[NUM_CHARS];
+    int n = 0;
+    for (int c = 0; c < NUM_CHARS; c++) {
+        lengths[c] = 0;
+        if (freq[c] > 0) keys[n++] = (freq[c] << 8) | c;
+    }
+    if (n == 0) return;
+    if (n == 1) {
+        lengths[keys[0] & 0xff] = 1;
+        return;
+    }
+    std::sort(keys, keys + n);
+
+    uint64_t A[NUM_CHARS];
+    for (int i = 0; i < n; i++)
+        A[i] = keys[i] >> 8;
+    moffatKatajainen(A, n);
+
+    // the least frequent char has the longest code
+    if (A[0] > (uint64_t) maxLength) {
+        packageMerge(freq, maxLength, lengths);
+        return;
+    }
+    for (int i = 0; i < n; i++)
+        lengths[keys[i] & 0xff] = (uint8_t) A[i];
+}
+
+/** Elias gamma code of x >= 1: floor(log2 x) zeros, then x in binary */
+inline void writeGamma(BinaryOut &out, unsigned int x) {
+    int nbits = 0;
+    while ((x >> nbits) > 1) nbits++;
+    out.writeBits(0, nbits);
+    out.writeBits(x, nbits + 1);
+}
+
+inline unsigned int readGamma(BinaryIn &in) {
+    int nbits = 0;
+    while (!in.readOneBitBool()) {
+        if (++nbits > 31) throw std::runtime_error("Invalid gamma code!");
+    }
+    return (unsigned int) (((uint64_t) 1 << nbits) | (nbits > 0 ? in.readBits(nbits) : 0));
+}
+
+inline int gammaBits(unsigned int x) {
+    int nbits = 0;
+    while ((x >> nbits) > 1) nbits++;
+    return 2 * nbits + 1;
+}
+
+// map a length difference to x >= 1 for writeGamma(): 0, -1, 1, -2, ... -> 1, 2, 3, 4, ...
+inline unsigned int zigzag(int d) {
+    return d >= 0 ? 2 * d + 1 : -2 * d;
+}
+
+inline int unzigzag(unsigned int x) {
+    return (x & 1) ? (int) (x / 2) : -(int) (x / 2);
+}
+
+/**
+ * Code lengths are stored in one of 2 layouts, whichever is smaller, after a
+ * 1-bit flag:
+ * - RUNS: each run of chars with the same length is the length in LENGTH_BITS
+ *   bits and the gamma-coded run size, best when most chars are used.
+ * - LIST: each used char is the gamma-coded gap from the previous used char
+ *   and its gamma-coded length change, then a final gap that reaches
+ *   NUM_CHARS. Best for the few distinct chars of short or sparse files.
+ */
+enum LengthsLayout { RUNS = 0, LIST = 1 };
+
+const int LIST_FIRST_LENGTH = 8; // length change of the first char in LIST is relative to this
+
+inline int runsLayoutBits(const uint8_t lengths[NUM_CHARS]) {
+    int bits = 0;
+    for (int c = 0; c < NUM_CHARS; ) {
+        int run = 1;
+        while (c + run < NUM_CHARS && lengths[c + run] == lengths[c]) run++;
+        bits += LENGTH_BITS + gammaBits(run);
+        c += run;
+    }
+    return bits;
+}
+
+inline int listLayoutBits(const uint8_t lengths[NUM_CHARS]) {
+    int bits = 0;
+    int prev = -1, prevLength = LIST_FIRST_LENGTH;
+    for (int c = 0; c < NUM_CHARS; c++) {
+        if (lengths[c] == 0) continue;
+        bits += gammaBits(c - prev) + gammaBits(zigzag(lengths[c] - prevLength));
+        prev = c;
+        prevLength = lengths[c];
+    }
+    return bits + gammaBits(NUM_CHARS - prev);
+}
+
+/** number of bits written by writeCodeLengths() */
+inline int codeLengthsBits(const uint8_t lengths[NUM_CHARS]) {
+    return 1 + std::min(runsLayoutBits(lengths), listLayoutBits(lengths));
+}
+
+inline void writeCodeLengths(const uint8_t lengths[NUM_CHARS], BinaryOut &out) {
+    if (runsLayoutBits(lengths) <= listLayoutBits(lengths)) {
+        out.writeBit(RUNS);
+        for (int c = 0; c < NUM_CHARS; ) {
+            int run = 1;
+            while (c + run < NUM_CHARS && lengths[c + run] == lengths[c]) run++;
+            out.writeBits(lengths[c], LENGTH_BITS);
+            writeGamma(out, run);
+            c += run;
+        }
+    }
+    else {
+        out.writeBit(LIST);
+        int prev = -1, prevLength = LIST_FIRST_LENGTH;
+        for (int c = 0; c < NUM_CHARS; c++) {
+            if (lengths[c] == 0) continue;
+            writeGamma(out, c - prev);
+            writeGamma(out, zigzag(lengths[c] - prevLength));
+            prev = c;
+            prevLength = lengths[c];
+        }
+        writeGamma(out, NUM_CHARS - prev);
+    }
+}
+
+inline void readCodeLengths(BinaryIn &in, uint8_t lengths[NUM_CHARS]) {
+    if (in.readOneBitBool() == RUNS) {
+        for (int c = 0; c < NUM_CHARS; ) {
+            uint8_t len = (uint8_t) in.readBits(LENGTH_BITS);
+            unsigned int run = readGamma(in);
+            if (run > (unsigned int) (NUM_CHARS - c)) throw std::runtime_error("Invalid code lengths!");
+            for (unsigned int i = 0; i < run; i++)
+                lengths[c++] = len;
+        }
+    }
+    else {
+        for (int c = 0; c < NUM_CHARS; c++)
+            lengths[c] = 0;
+        int c = -1, prevLength = LIST_FIRST_LENGTH;
+        while (true) {
+            unsigned int gap = readGamma(in);
+            if (gap > (unsigned int) (NUM_CHARS - c)) throw std::runtime_error("Invalid code lengths!");
+            c += (int) gap;
+            if (c == NUM_CHARS) break;
+            int len = prevLength + unzigzag(readGamma(in));
+            if (len < 1 || len > MAX_CODE_LENGTH) throw std::runtime_error("Invalid code lengths!");
+            lengths[c] = (uint8_t) len;
+            prevLength = len;
+        }
+    }
+    checkCodeLengths(lengths);
+}
+
+#endif
@@ -0,0 +1,136 @@
+/**
+ * Read-only view of a whole input file, shared by compress.cpp and
+ * decompress.cpp.
+ * Regular files are mapped with mmap, so nothing is copied and the kernel
+ * reads ahead (MADV_SEQUENTIAL) while the data is being scanned, see
+ * release() for dropping what's done. Pipes and other unmappable inputs are
+ * read into memory with large read() calls.
+ */
+
+#ifndef INPUT_FILE_H
+#define INPUT_FILE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+class InputFile {
+    using byte = unsigned char;
+
+    static const size_t READ_SIZE = 1 << 20; // bytes per read() call for unmappable inputs
+
+private:
+    const byte *bytes; // the whole file, either mapped or in buffer
+    size_t length; // number of bytes in the file
+    bool ok; // true if the file was read successfully
+    void *mapped; // start of the mapping, nullptr if the file is not mapped
+    size_t released; // bytes at the start of the mapping given back by release()
+    std::vector<byte> buffer; // file content when it's not mapped
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+#ifdef _WIN32
+    void open(const std::string &path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) return;
+        buffer.resize((size_t) in.tellg());
+        in.seekg(0, std::ios::beg);
+        if (!in.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) return;
+        bytes = buffer.data();
+        length = buffer.size();
+        ok = true;
+    }
+#else
+    void open(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *p = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, (size_t) st.st_size, MADV_SEQUENTIAL);
+                mapped = p;
+                bytes = static_cast<const byte*>(p);
+                length = (size_t) st.st_size;
+                ok = true;
+                ::close(fd);
+                return;
+            }
+        }
+
+        // fall back to reading everything, e.g. from a pipe
+        ok = readAll(fd);
+        bytes = buffer.data();
+        length = buffer.size();
+        ::close(fd);
+    }
+
+    bool readAll(int fd) {
+        size_t used = 0;
+        while (true) {
+            if (buffer.size() - used < READ_SIZE) buffer.resize(std::max(2 * buffer.size(), used + READ_SIZE));
+            ssize_t n = ::read(fd, buffer.data() + used, buffer.size() - used);
+            if (n < 0) return false;
+            if (n == 0) break;
+            used += (size_t) n;
+        }
+        buffer.resize(used);
+        return true;
+    }
+#endif
+
+public:
+    InputFile(const std::string &path) : bytes(nullptr), length(0), ok(false), mapped(nullptr), released(0) {
+        open(path);
+    }
+
+    ~InputFile() {
+#ifndef _WIN32
+        if (mapped != nullptr) munmap(mapped, length);
+#endif
+    }
+
+    explicit operator bool() const {
+        return ok;
+    }
+
+    const byte* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    /**
+     * Tell the kernel that the bytes before end won't be read again, s.t. the
+     * pages of a mapped multi-GB input don't pile up in memory. Reading them
+     * again is still fine, it only costs page faults.
+     */
+    void release(const byte *end) {
+#ifndef _WIN32
+        if (mapped == nullptr) return;
+        size_t page = (size_t) sysconf(_SC_PAGESIZE);
+        size_t done = (size_t) (end - bytes) / page * page;
+        if (done > released) {
+            madvise(static_cast<byte*>(mapped) + released, done - released, MADV_DONTNEED);
+            released = done;
+        }
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * Output file written block by block, shared by compress.cpp and
+ * decompress.cpp.
+ * Both tools produce their output one block at a time into a small buffer
+ * that stays in cache, which is then handed to the kernel with a single
+ * write() loop. Nothing depends on the output size, so multi-GB outputs and
+ * pipes work the same way, and it's faster than faulting in the pages of a
+ * mapped output file one by one.
+ */
+
+#ifndef OUTPUT_FILE_H
+#define OUTPUT_FILE_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+class OutputFile {
+    using byte = unsigned char;
+
+private:
+#ifdef _WIN32
+    std::ofstream out;
+#else
+    int fd;
+#endif
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+public:
+#ifdef _WIN32
+    OutputFile(const std::string &path) : out(path, std::ios::binary) {}
+
+    explicit operator bool() const {
+        return (bool) out;
+    }
+
+    /** Append size bytes at p to the file */
+    void write(const byte *p, size_t size) {
+        out.write(reinterpret_cast<const char*>(p), size);
+        if (!out) throw std::runtime_error("Failed to write file!");
+    }
+
+    void close() {
+        out.close();
+        if (!out) throw std::runtime_error("Failed to write file!");
+    }
+#else
+    OutputFile(const std::string &path) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    ~OutputFile() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    explicit operator bool() const {
+        return fd >= 0;
+    }
+
+    /** Append size bytes at p to the file */
+    void write(const byte *p, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0) throw std::runtime_error("Failed to write file!");
+            p += n;
+            size -= (size_t) n;
+        }
+    }
+
+    void close() {
+        bool ok = ::close(fd) == 0;
+        fd = -1;
+        if (!ok) throw std::runtime_error("Failed to write file!");
+    }
+#endif
+};
+
+#endif
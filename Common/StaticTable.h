@@ -0,0 +1,67 @@
+/**
+ * Pretrained Huffman code, shared by compress.cpp and decompress.cpp.
+ * Files of the same kind (e.g. the per-die dumps of one product) have almost
+ * the same byte distribution, so a code trained once on a corpus serves all
+ * of them: blocks coded with it skip the histogram, the code construction and
+ * the code lengths in the block header.
+ * The code lengths are kept in a model file, written with writeCodeLengths().
+ * Compressed files only refer to the model by its ID, the CRC32C of the
+ * lengths, so decompressing with the wrong model is caught up front.
+ */
+
+#ifndef STATIC_TABLE_H
+#define STATIC_TABLE_H
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "BinaryIn.h"
+#include "BinaryOut.h"
+#include "Checksum.h"
+#include "Huffman.h"
+#include "InputFile.h"
+#include "OutputFile.h"
+
+
+struct StaticTable {
+    uint8_t lengths[NUM_CHARS];
+    uint32_t id;
+};
+
+inline uint32_t staticTableId(const uint8_t lengths[NUM_CHARS]) {
+    return crc32c(lengths, NUM_CHARS);
+}
+
+/**
+ * Build the static code for the byte frequencies of a training corpus.
+ * Every byte gets a code, even if the corpus doesn't have it, since the files
+ * it will be used on might.
+ */
+inline void trainStaticTable(const uint64_t freq[NUM_CHARS], int maxLength, StaticTable &table) {
+    uint64_t counts[NUM_CHARS];
+    for (int c = 0; c < NUM_CHARS; c++)
+        counts[c] = freq[c] + 1;
+    buildCodeLengths(counts, maxLength, table.lengths);
+    table.id = staticTableId(table.lengths);
+}
+
+inline void saveStaticTable(const StaticTable &table, OutputFile &file) {
+    std::vector<unsigned char> buffer((codeLengthsBits(table.lengths) + 7) / 8);
+    BinaryOut out(buffer.data(), buffer.size());
+    writeCodeLengths(table.lengths, out);
+    out.close();
+    file.write(buffer.data(), buffer.size());
+    file.close();
+}
+
+inline void loadStaticTable(const InputFile &file, StaticTable &table) {
+    BinaryIn in(file.data(), file.size());
+    readCodeLengths(in, table.lengths);
+    if (in.overrun()) throw std::runtime_error("Invalid model file!");
+    for (int c = 0; c < NUM_CHARS; c++)
+        if (table.lengths[c] == 0) throw std::runtime_error("Invalid model file!");
+    table.id = staticTableId(table.lengths);
+}
+
+#endif
@@ -6,226 +6,497 @@
  * To compile this program on linux, use: g++ -std=c++11 -o compress compress.cpp
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
 #include <string>
-#include <unordered_map>
-#include <queue>
 #include <vector>
 
+#include "../Common/BinaryOut.h"
+#include "../Common/Checksum.h"
+#include "../Common/Frame.h"
+#include "../Common/Histogram.h"
+#include "../Common/Huffman.h"
+#include "../Common/InputFile.h"
+#include "../Common/OutputFile.h"
+#include "../Common/StaticTable.h"
+
 using std::cout;
 using std::endl;
-using std::ifstream;
-using std::ios;
-using std::istreambuf_iterator;
-using std::ofstream;
 using std::string;
-using std::unordered_map;
-using std::priority_queue;
-using std::vector;
 
 
-/**
- * Utility class for writing bits to ofstream.
- * Basically it writes 8 bits from buffer to ofstream when 8 bits are accumulated.
- */
-class BinaryOut {
-    // Use unsigned char to represent 8 bits, s.t. >> pads in 0
-    using byte = unsigned char;
+const int MIN_CODE_LENGTH_LIMIT = 11; // codes are allowed to be 11 ~ MAX_CODE_LENGTH bits long
+const int DEFAULT_CODE_LENGTH_LIMIT = 15;
 
-    // technically bool is still 8-bit, but let's just use it like 1 bit
-    // where true is 1, false is 0
-    using bit = bool;
+const size_t SPLIT_STEP = (size_t) 16 << 10; // blocks end at a multiple of this, or at the end of the file
+const double CODE_LENGTH_COST_BITS = 4; // rough cost of the code length of each used char
 
-private:
-    byte buffer; // 8-bit buffer
-    int n; // buffer size
-    ofstream &out; // reference to output file stream
 
-    void writeBitHelper(bit x) {
-        // write bit to buffer LSB
-        buffer <<= 1;
-        if (x) buffer |= 1;
+/***********************************
+ * Below are compression functions *
+ ***********************************/
 
-        n++;
-        if (n == 8) clearBuffer(); // write 8-bit if buffer is full
-    }
+// number of bytes of the varint x, see writeVarint()
+int varintBytes(uint64_t x) {
+    int n = 1;
+    for (; x >= 0x80; x >>= 7) n++;
+    return n;
+}
 
-    void writeByteHelper(byte x) {
-        // When buffer is empty, we can directly write a byte to file
-        if (n == 0) {
-            out.write(reinterpret_cast<const char*>(&x), sizeof(byte));
-        }
-        // write one bit at a time to the buffer, from MSB to LSB
-        else {
-            for (int i = 0; i < 8; i++) {
-                bool b = ((x >> (8 - i - 1)) & 1) == 1;
-                writeBitHelper(b);
-            }
-        }
+// length of the run of equal bytes starting at bytes[i]
+size_t runLength(const unsigned char *bytes, size_t size, size_t i) {
+    // compare 8 bytes at a time while the run is long
+    uint64_t pattern = 0x0101010101010101ULL * bytes[i];
+    size_t j = i + 1;
+    for (uint64_t word; j + 8 <= size; j += 8) {
+        std::memcpy(&word, bytes + j, sizeof(word));
+        if (word != pattern) break;
     }
+    while (j < size && bytes[j] == bytes[i]) j++;
+    return j - i;
+}
 
-    void clearBuffer() {
-        if (n == 0) return;
+// size of the checksum, type and length of a block of size bytes
+size_t blockHeaderBytes(size_t size) {
+    return (CHECKSUM_BITS + BLOCK_TYPE_BITS) / 8 + varintBytes(size);
+}
 
-        // write out bits in buffer, padding with 0 from right
-        if (n > 0) buffer <<= (8 - n);
-        out.write(reinterpret_cast<const char*>(&buffer), sizeof(byte));
+/**
+ * Order-0 estimate of the bits of a block of size bytes with the char counts
+ * freq, coded with a code of its own: its entropy plus the block header and
+ * the code lengths.
+ */
+double blockCost(const uint64_t freq[NUM_CHARS], size_t size) {
+    double bits = blockHeaderBytes(size) * 8 + (NUM_STREAMS - 1) * STREAM_SIZE_BITS;
+    for (int c = 0; c < NUM_CHARS; c++)
+        if (freq[c] != 0) bits += freq[c] * std::log2((double) size / freq[c]) + CODE_LENGTH_COST_BITS;
+    return bits;
+}
 
-        n = 0;
-        buffer = 0;
+// number of tables of counts splitBlock() fills for blocks of at most maxLength bytes
+size_t prefixTables(size_t maxLength) {
+    return (maxLength + SPLIT_STEP - 1) / SPLIT_STEP + 1;
+}
+
+/**
+ * Length of the block starting at bytes, given size bytes are left and a
+ * block holds at most maxLength.
+ * The block grows SPLIT_STEP bytes at a time, as long as coding the next
+ * chunk along with the block is estimated to cost no more than coding it as
+ * a block of its own, see blockCost(). So homogeneous regions end up in
+ * blocks of maxLength, and a block ends where the statistics change, e.g.
+ * where a fuse map starts after a header.
+ * Table k of prefixFreq (see prefixTables()) gets the char counts of the
+ * bytes before min(k * SPLIT_STEP, length), s.t. buildBlockCode() doesn't
+ * count the whole block again.
+ */
+size_t splitBlock(const unsigned char *bytes, size_t size, size_t maxLength, uint64_t *prefixFreq) {
+    size_t length = std::min(size, SPLIT_STEP);
+    std::fill(prefixFreq, prefixFreq + 2 * NUM_CHARS, 0);
+    countChars(bytes, length, prefixFreq + NUM_CHARS);
+    double cost = blockCost(prefixFreq + NUM_CHARS, length);
+    for (size_t k = 1; length < size && length < maxLength; k++) {
+        size_t step = std::min(SPLIT_STEP, std::min(size, maxLength) - length);
+        uint64_t chunk[NUM_CHARS] = {};
+        countChars(bytes + length, step, chunk);
+        const uint64_t *freq = prefixFreq + k * NUM_CHARS;
+        uint64_t *merged = prefixFreq + (k + 1) * NUM_CHARS;
+        for (int c = 0; c < NUM_CHARS; c++)
+            merged[c] = freq[c] + chunk[c];
+        double mergedCost = blockCost(merged, length + step);
+        if (mergedCost > cost + blockCost(chunk, step)) break;
+
+        cost = mergedCost;
+        length += step;
     }
+    return length;
+}
 
-public:
-    BinaryOut(ofstream &out) : out(out), n(0), buffer(0) {}
+/**
+ * Size of the runs of an RLE_BLOCK, stops counting once it reaches limit,
+ * s.t. blocks that are not made of long runs are rejected early.
+ */
+size_t rleBytes(const unsigned char *bytes, size_t size, size_t limit) {
+    size_t total = 0;
+    for (size_t i = 0; i < size && total < limit; ) {
+        size_t run = runLength(bytes, size, i);
+        total += 1 + varintBytes(run);
+        i += run;
+    }
+    return total;
+}
 
-    void writeBit(bit x) {
-        writeBitHelper(x);
+/** How one block is coded and its exact compressed size */
+struct BlockCode {
+    BlockType type;
+    uint8_t lengths[NUM_CHARS];
+    int streams; // see blockStreams()
+    size_t streamBytes[NUM_STREAMS]; // size of each stream, padding included
+    size_t bytes; // size of the whole block, padding included
+    const unsigned char *streamData; // the coded streams of a STATIC_BLOCK, coded up front
+};
+
+void writeRLEBlock(const unsigned char *bytes, size_t size, const BlockCode &, BinaryOut &out) {
+    for (size_t i = 0; i < size; ) {
+        size_t run = runLength(bytes, size, i);
+        out.writeByte(bytes[i]);
+        writeVarint(run, out);
+        i += run;
     }
+}
 
-    void writeByte(byte x) {
-        writeByteHelper(x);
+// switch to a STORED_BLOCK or an RLE_BLOCK if it's smaller than the coded block
+void chooseBlockType(const unsigned char *bytes, size_t size, BlockCode &block) {
+    // store the block as is if the Huffman code doesn't make it any smaller
+    size_t storedBytes = blockHeaderBytes(size) + size;
+    if (block.bytes >= storedBytes) {
+        block.type = STORED_BLOCK;
+        block.bytes = storedBytes;
     }
 
-    void writeUnsignedInt(unsigned int x) {
-        // use unsigned to make sure >> pads in 0 from left
-        writeByteHelper((x >> 24) & 0xff); // MSB
-        writeByteHelper((x >> 16) & 0xff);
-        writeByteHelper((x >> 8) & 0xff);
-        writeByteHelper((x >> 0) & 0xff); // LSB
+    size_t runBytes = blockHeaderBytes(size) + rleBytes(bytes, size, block.bytes);
+    if (runBytes < block.bytes) {
+        block.type = RLE_BLOCK;
+        block.bytes = runBytes;
     }
+}
 
-    void close() {
-        clearBuffer();
+/**
+ * Size of the streams coded with the code lengths, each stream is padded on
+ * its own. Returns SIZE_MAX if a char of the block has no code.
+ */
+size_t streamsBytes(const uint64_t streamFreq[][NUM_CHARS], int streams, const uint8_t lengths[NUM_CHARS],
+                    size_t streamBytes[NUM_STREAMS]) {
+    size_t total = 0;
+    for (int s = 0; s < streams; s++) {
+        uint64_t bits = 0;
+        for (int c = 0; c < NUM_CHARS; c++) {
+            if (streamFreq[s][c] != 0 && lengths[c] == 0) return SIZE_MAX;
+            bits += streamFreq[s][c] * lengths[c];
+        }
+        streamBytes[s] = (size_t) ((bits + 7) / 8);
+        total += streamBytes[s];
     }
-};
+    return total;
+}
 
+/**
+ * Pick the code of the block: its own Huffman code, or previousLengths (the
+ * code of the last HUFFMAN_BLOCK, nullptr if it can't be repeated) when
+ * coding with it isn't larger than writing out a new code. Neighbouring
+ * blocks of a dump mostly have the same statistics, so the code lengths are
+ * saved, and so is building the decode tables again.
+ */
+BlockCode buildBlockCode(const unsigned char *bytes, size_t size, const uint64_t *prefixFreq, int maxCodeLength,
+                         const uint8_t *previousLengths) {
+    BlockCode block;
+    block.type = HUFFMAN_BLOCK;
+    block.streams = blockStreams(size);
+    block.streamData = nullptr;
+    size_t segment = streamLength(size, block.streams);
+
+    // Record the frequency of each char, per stream since each one is padded on its own.
+    // The counts before each stream start from the nearest table of splitBlock(), so only
+    // the bytes between the last multiple of SPLIT_STEP and the stream are counted again
+    uint64_t before[NUM_STREAMS + 1][NUM_CHARS] = {};
+    for (int s = 1; s < block.streams; s++) {
+        size_t begin = std::min(size, s * segment);
+        size_t k = begin / SPLIT_STEP;
+        std::memcpy(before[s], prefixFreq + k * NUM_CHARS, sizeof(before[s]));
+        countChars(bytes + k * SPLIT_STEP, begin - k * SPLIT_STEP, before[s]);
+    }
+    const uint64_t *freq = prefixFreq + (size + SPLIT_STEP - 1) / SPLIT_STEP * NUM_CHARS;
+    std::memcpy(before[block.streams], freq, sizeof(before[block.streams]));
+    uint64_t streamFreq[NUM_STREAMS][NUM_CHARS];
+    for (int s = 0; s < block.streams; s++)
+        for (int c = 0; c < NUM_CHARS; c++)
+            streamFreq[s][c] = before[s + 1][c] - before[s][c];
+
+    // compute the code length of each char based on the frequency table,
+    // s.t. the most frequent char gets the shortest code
+    buildCodeLengths(freq, maxCodeLength, block.lengths);
+
+    uint64_t headerBits = blockHeaderBytes(size) * 8;
+    if (block.streams > 1) headerBits += (block.streams - 1) * STREAM_SIZE_BITS;
+    block.bytes = (size_t) ((headerBits + codeLengthsBits(block.lengths) + 7) / 8) +
+                  streamsBytes(streamFreq, block.streams, block.lengths, block.streamBytes);
+
+    // a single char is left to an RLE_BLOCK, the decoder only takes codes of at least 2 chars
+    if (std::count_if(block.lengths, block.lengths + NUM_CHARS, [](uint8_t len) { return len != 0; }) < 2)
+        block.bytes = SIZE_MAX;
+
+    if (previousLengths != nullptr) {
+        size_t streamBytes[NUM_STREAMS];
+        size_t coded = streamsBytes(streamFreq, block.streams, previousLengths, streamBytes);
+        if (coded != SIZE_MAX && (size_t) ((headerBits + 7) / 8) + coded <= block.bytes) {
+            block.type = REPEAT_BLOCK;
+            std::memcpy(block.lengths, previousLengths, NUM_CHARS);
+            std::copy(streamBytes, streamBytes + block.streams, block.streamBytes);
+            block.bytes = (size_t) ((headerBits + 7) / 8) + coded;
+        }
+    }
 
-/** Node class for the Trie */
-class Node {
-public:
-    char ch; // NOTE: char range is -128 ~ 127
-    int freq;
-    Node* left;
-    Node* right;
+    chooseBlockType(bytes, size, block);
+    return block;
+}
 
-    Node(char ch, int freq, Node* left, Node* right) :
-        ch(ch), freq(freq), left(left), right(right) {}
+// write the Huffman codes of each segment of the block to its own stream
+void writeStreams(const unsigned char *bytes, size_t size, int streams, const Codeword table[NUM_CHARS],
+                  BinaryOut &out) {
+    size_t segment = streamLength(size, streams);
+    for (int s = 0; s < streams; s++) {
+        size_t end = std::min(size, (s + 1) * segment);
+        for (size_t i = s * segment; i < end; i++) {
+            const Codeword &cw = table[bytes[i]];
+            out.writeBits(cw.code, cw.length);
+        }
+        out.alignToByte();
+    }
+}
 
-    bool isLeaf() {
-        return (left == nullptr) && (right == nullptr);
+/**
+ * Code the block with the static table to streamData right away: there is no
+ * histogram to compute the stream sizes from, and coding is about as fast.
+ */
+BlockCode buildStaticBlockCode(const unsigned char *bytes, size_t size, const Codeword table[NUM_CHARS],
+                               std::vector<unsigned char> &streamData) {
+    BlockCode block;
+    block.type = STATIC_BLOCK;
+    block.streams = blockStreams(size);
+
+    // every stream is padded to whole bytes
+    streamData.resize((size * MAX_CODE_LENGTH + 7) / 8 + NUM_STREAMS);
+    block.streamData = streamData.data();
+    BinaryOut out(streamData.data(), streamData.size());
+    size_t segment = streamLength(size, block.streams);
+    size_t coded = 0;
+    for (int s = 0; s < block.streams; s++) {
+        size_t begin = std::min(size, s * segment);
+        writeStreams(bytes + begin, std::min(size - begin, segment), 1, table, out);
+        block.streamBytes[s] = out.size() - coded;
+        coded = out.size();
     }
-};
+    out.close();
 
+    uint64_t headerBits = blockHeaderBytes(size) * 8;
+    if (block.streams > 1) headerBits += (block.streams - 1) * STREAM_SIZE_BITS;
+    block.bytes = (size_t) ((headerBits + 7) / 8) + coded;
+    chooseBlockType(bytes, size, block);
+    return block;
+}
 
-/** Node Pointer comparator for the priority_queue of Node pointers */
-struct NodePtrComparator {
-    bool operator()(const Node* lhs, const Node* rhs) const {
-        return lhs->freq > rhs->freq;
+// write the streams of the block with the code of block.lengths, which the decoder already has
+void writeRepeatBlock(const unsigned char *bytes, size_t size, const BlockCode &block, BinaryOut &out) {
+    // jump table to the start of each stream
+    if (block.streams > 1) {
+        for (int s = 0; s < block.streams - 1; s++)
+            out.writeBits(block.streamBytes[s], STREAM_SIZE_BITS);
     }
-};
+    out.alignToByte();
 
+    // construct table with the canonical code for each char
+    Codeword table[NUM_CHARS];
+    buildCanonicalCodes(block.lengths, table);
 
-/***********************************
- * Below are compression functions *
- ***********************************/
-
-Node* buildTrie(unordered_map<char, int> &freq) {
-    // push trees with only one node into the Min PQ
-    priority_queue<Node*, vector<Node*>, NodePtrComparator> pq;
-    for (auto it : freq)
-        pq.push(new Node(it.first, it.second, nullptr, nullptr));
+    // write Huffman code to the compressed binary file, one stream per segment
+    writeStreams(bytes, size, block.streams, table, out);
+}
 
-    // Merge 2 smallest trees into a larger tree until we have only 1 tree
-    while (pq.size() > 1) {
-        Node* left = pq.top();
-        pq.pop();
-        Node* right = pq.top();
-        pq.pop();
-        pq.push(new Node(0, left->freq + right->freq, left, right));
-    }
-    Node* root = pq.top();
-    pq.pop();
-    return root;
+void writeHuffmanBlock(const unsigned char *bytes, size_t size, const BlockCode &block, BinaryOut &out) {
+    // write code lengths for decompression
+    writeCodeLengths(block.lengths, out);
+    writeRepeatBlock(bytes, size, block, out);
 }
 
-void buildTable(unordered_map<char, string> &table, Node* n, string code) {
-    if (n->isLeaf()) {
-        table[n->ch] = code;
-    }
-    else {
-        buildTable(table, n->left, code + "0");
-        buildTable(table, n->right, code + "1");
-    }
+void writeStoredBlock(const unsigned char *bytes, size_t size, const BlockCode &, BinaryOut &out) {
+    out.writeBytes(bytes, size);
 }
 
-/** write a prefix traversal of the Trie */
-void writeTrie(Node* n, BinaryOut &out) {
-    if (n->isLeaf()) {
-        out.writeBit(1);
-        out.writeByte(n->ch); // note that char to unsigned char won't change underlying bit pattern
-    }
-    else {
-        out.writeBit(0);
-        writeTrie(n->left, out);
-        writeTrie(n->right, out);
-    }
+void writeStaticBlock(const unsigned char *, size_t, const BlockCode &block, BinaryOut &out) {
+    size_t coded = 0;
+    for (int s = 0; s < block.streams - 1; s++)
+        out.writeBits(block.streamBytes[s], STREAM_SIZE_BITS);
+    out.alignToByte();
+    for (int s = 0; s < block.streams; s++)
+        coded += block.streamBytes[s];
+    out.writeBytes(block.streamData, coded);
 }
 
-void compress(string &bytes, BinaryOut &out) {
-    // Record the frequency of each char
-    unordered_map<char, int> freq;
-    for (char c : bytes)
-        freq[c]++;
+// writes the content of a block of size bytes with the codec chosen for it
+typedef void (*BlockWriter)(const unsigned char *bytes, size_t size, const BlockCode &block, BinaryOut &out);
 
-    // construct Trie based on the frequency table
-    Node* root = buildTrie(freq);
+// codecs by block type, see Frame.h
+const BlockWriter BLOCK_WRITERS[NUM_BLOCK_TYPES] = {
+    writeHuffmanBlock, // HUFFMAN_BLOCK
+    writeStoredBlock, // STORED_BLOCK
+    writeRLEBlock, // RLE_BLOCK
+    writeStaticBlock, // STATIC_BLOCK
+    writeRepeatBlock, // REPEAT_BLOCK
+};
+
+void writeBlock(const unsigned char *bytes, size_t size, const BlockCode &block, BinaryOut &out) {
+    out.writeUnsignedInt(crc32c(bytes, size));
+    out.writeBits(block.type, BLOCK_TYPE_BITS);
+    writeVarint(size, out);
+    BLOCK_WRITERS[block.type](bytes, size, block, out);
+}
 
-    // construct table with code for each char s.t. the most frequent char
-    // gets the shortest prefix-free binary code
-    unordered_map<char, string> table;
-    buildTable(table, root, "");
+/**
+ * Compress the input one block at a time: each block is encoded to a buffer
+ * that is reused for the next one and written out right away, so memory use
+ * doesn't grow with the input and a block is still in cache when it's
+ * encoded after counting its chars.
+ */
+void compress(InputFile &input, OutputFile &file, int maxCodeLength, size_t blockSize, bool seekIndex,
+              const StaticTable *staticTable) {
+    const unsigned char *bytes = input.data();
+    size_t size = input.size();
+    int flags = (seekIndex ? FRAME_SEEK_INDEX : 0) | (staticTable != nullptr ? FRAME_STATIC_TABLE : 0);
+    FrameHeader header = { CODEC_HUFFMAN, size, blockSize, flags, staticTable != nullptr ? staticTable->id : 0 };
+
+    Codeword staticCodes[NUM_CHARS];
+    if (staticTable != nullptr) buildCanonicalCodes(staticTable->lengths, staticCodes);
+    std::vector<unsigned char> streamData;
+    std::vector<uint64_t> prefixFreq(prefixTables(blockSize) * NUM_CHARS);
+
+    // code of the last HUFFMAN_BLOCK, if there was one
+    uint8_t previousLengths[NUM_CHARS];
+    bool hasPrevious = false;
+
+    std::vector<unsigned char> buffer(MAX_FRAME_HEADER_BYTES);
+    BinaryOut out(buffer.data(), buffer.size());
+    writeFrameHeader(header, out);
+    out.close();
+    file.write(buffer.data(), out.size());
+    size_t compressedSize = out.size();
+
+    std::vector<SeekEntry> index;
+    for (size_t offset = 0; offset < size; ) {
+        // blocks coded with the static table don't pay for a code of their own, so they aren't split
+        const unsigned char *block = bytes + offset;
+        size_t length = staticTable != nullptr ? std::min(blockSize, size - offset)
+                                               : splitBlock(block, size - offset, blockSize, prefixFreq.data());
+        BlockCode code = staticTable != nullptr ? buildStaticBlockCode(block, length, staticCodes, streamData)
+                                                : buildBlockCode(block, length, prefixFreq.data(), maxCodeLength,
+                                                                 hasPrevious ? previousLengths : nullptr);
+        if (code.type == HUFFMAN_BLOCK) {
+            std::memcpy(previousLengths, code.lengths, NUM_CHARS);
+            hasPrevious = true;
+        }
 
-    // write Trie data for decompression
-    writeTrie(root, out);
+        // The exact compressed size is known before encoding anything
+        if (buffer.size() < code.bytes) buffer.resize(code.bytes);
+        BinaryOut blockOut(buffer.data(), code.bytes);
+        writeBlock(block, length, code, blockOut);
+        blockOut.close();
+        file.write(buffer.data(), code.bytes);
+        input.release(block + length);
+
+        index.push_back({ compressedSize, offset });
+        compressedSize += code.bytes;
+        offset += length;
+    }
 
-    // Write number of bytes in the original binary file
-    unsigned int length = (unsigned int) bytes.length(); // this cast is legal only because size is guaranteed to be < 1MB
-    out.writeUnsignedInt(length);
+    if (seekIndex) {
+        buffer.resize(seekIndexBytes(index.size()));
+        BinaryOut indexOut(buffer.data(), buffer.size());
+        writeSeekIndex(index, indexOut);
+        indexOut.close();
+        file.write(buffer.data(), buffer.size());
+    }
+    file.close();
+}
 
-    // write Huffman code to the compressed binary file
-    for (char byte : bytes) {
-        string code = table[byte];
-        for (char bit : code) {
-            if (bit == '0')
-                out.writeBit(0);
-            else
-                out.writeBit(1);
-        }
+/** Train a static table on the files, see StaticTable.h */
+bool train(char **paths, int count, OutputFile &model, int maxCodeLength) {
+    uint64_t freq[NUM_CHARS] = {};
+    for (int i = 0; i < count; i++) {
+        InputFile file(paths[i]);
+        if (!file) return false;
+        countChars(file.data(), file.size(), freq);
     }
 
-    out.close();
+    StaticTable table;
+    trainStaticTable(freq, maxCodeLength, table);
+    saveStaticTable(table, model);
+    return true;
 }
 
 int main(int argc, char **argv)
 {
-    if (argc != 2) {
-        cout << "Usage: compress.exe filename.bin" << endl;
+    // optional "-l maxCodeLength", "-b blockSizeKB", "-i" and "-m model.bin" before the file name,
+    // or "-t model.bin" to train a static table on the files
+    int maxCodeLength = DEFAULT_CODE_LENGTH_LIMIT;
+    size_t blockSize = DEFAULT_BLOCK_SIZE;
+    bool seekIndex = false;
+    string modelPath, trainPath;
+    while (argc >= 3) {
+        string option = argv[1];
+        if (option == "-i") {
+            seekIndex = true;
+            argv += 1;
+            argc -= 1;
+        }
+        else if (argc >= 4 && (option == "-l" || option == "-b" || option == "-m" || option == "-t")) {
+            if (option == "-l")
+                maxCodeLength = std::atoi(argv[2]);
+            else if (option == "-b")
+                blockSize = (size_t) std::atoi(argv[2]) << 10;
+            else if (option == "-m")
+                modelPath = argv[2];
+            else
+                trainPath = argv[2];
+            argv += 2;
+            argc -= 2;
+        }
+        else {
+            break;
+        }
+    }
+    bool training = !trainPath.empty() && modelPath.empty() && argc >= 2;
+    if ((argc != 2 && !training) || maxCodeLength < MIN_CODE_LENGTH_LIMIT || maxCodeLength > MAX_CODE_LENGTH ||
+        blockSize < MIN_BLOCK_SIZE || blockSize > MAX_BLOCK_SIZE) {
+        cout << "Usage: compress.exe [-l maxCodeLength] [-b blockSizeKB] [-i] [-m model.bin] filename.bin" << endl;
+        cout << "       compress.exe [-l maxCodeLength] -t model.bin filename.bin..." << endl;
+        cout << "maxCodeLength is " << MIN_CODE_LENGTH_LIMIT << " ~ " << MAX_CODE_LENGTH
+             << ", " << DEFAULT_CODE_LENGTH_LIMIT << " by default" << endl;
+        cout << "blockSizeKB is the largest block, " << (MIN_BLOCK_SIZE >> 10) << " ~ " << (MAX_BLOCK_SIZE >> 10)
+             << ", " << (DEFAULT_BLOCK_SIZE >> 10) << " by default" << endl;
+        cout << "-i appends a seek index for decompressing byte ranges" << endl;
+        cout << "-t trains a static table on the files and saves it to model.bin, -m codes with it" << endl;
+        return 1;
+    }
+
+    if (training) {
+        OutputFile model(trainPath);
+        if (model && train(argv + 1, argc - 1, model, maxCodeLength)) return 0;
+        cout << "Failed to open file." << endl;
         return 1;
     }
 
+    StaticTable table;
+    if (!modelPath.empty()) {
+        InputFile model(modelPath);
+        if (!model) {
+            cout << "Failed to open file." << endl;
+            return 1;
+        }
+        loadStaticTable(model, table);
+    }
+
     // open the files
     string inputPath = argv[1];
-    ifstream iFile(inputPath, ios::binary);
+    InputFile iFile(inputPath);
 
     string removeExtension = inputPath.substr(0, inputPath.length() - 4); // assume extension is 4 chars long
-    ofstream oFile(removeExtension + "Compressed.bin", ios::binary);
-    BinaryOut out(oFile);
+    OutputFile oFile(removeExtension + "Compressed.bin");
 
     if (iFile && oFile) {
-        // get the bytes in the file as 8-bit chars and store them in a string
-        string bytes((istreambuf_iterator<char>(iFile)), istreambuf_iterator<char>());
-        compress(bytes, out);
+        compress(iFile, oFile, maxCodeLength, blockSize, seekIndex, modelPath.empty() ? nullptr : &table);
     } else {
         cout << "Failed to open file." << endl;
         return 1;
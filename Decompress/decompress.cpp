@@ -7,248 +7,580 @@
  * To compile this program on linux, use: g++ -std=c++11 -o decompress decompress.cpp
  */
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
-#include <fstream>
 #include <string>
+#include <vector>
+
+#include "../Common/BinaryIn.h"
+#include "../Common/BinaryOut.h"
+#include "../Common/Checksum.h"
+#include "../Common/Frame.h"
+#include "../Common/Huffman.h"
+#include "../Common/InputFile.h"
+#include "../Common/OutputFile.h"
+#include "../Common/StaticTable.h"
 
 using std::runtime_error;
 using std::cout;
 using std::endl;
-using std::ifstream;
-using std::ios;
-using std::istreambuf_iterator;
-using std::ofstream;
 using std::string;
 
 
+const int MAX_MULTI_CHARS = 4; // max chars emitted by one multi-symbol lookup
+
+
 /**
- * Utility class for writing bits to ofstream.
- * Basically it writes 8 bits from buffer to ofstream when 8 bits are accumulated.
+ * Entry of the table-driven decoder, see buildDecodeTable().
+ * A leaf entry gives the decoded char and how many bits its code uses in this
+ * table, a link entry points to a subtable indexed by the following bits.
  */
-class BinaryOut {
-    using byte = unsigned char;
-    using bit = bool;
+struct DecodeEntry {
+    uint16_t value; // decoded char for a leaf, offset of the subtable for a link
+    uint8_t bits; // bits to consume, for a link it's the width of this table
+    uint8_t subBits; // index width of the linked subtable, 0 for a leaf
+};
 
-private:
-    byte buffer; // 8-bit buffer
-    int n; // buffer size
-    ofstream &out; // reference to output file stream
+const int ROOT_BITS = 11; // the root table has 2^11 entries and covers most codes
+const int SUB_BITS = MAX_CODE_LENGTH - ROOT_BITS; // width of a subtable for the rare longer codes
 
-    void writeBitHelper(bit x) {
-        // write bit to buffer LSB
-        buffer <<= 1;
-        if (x) buffer |= 1;
 
-        n++;
-        if (n == 8) clearBuffer(); // write 8-bit if buffer is full
-    }
+/**
+ * Entry of the multi-symbol decode table, see buildMultiTable().
+ * Skewed data has mostly 1 or 2 bit codes, so one ROOT_BITS peek usually
+ * holds several complete codes that can be emitted at once.
+ */
+struct MultiEntry {
+    unsigned char chars[MAX_MULTI_CHARS];
+    uint8_t count; // number of chars decoded, 0 if the first code is longer than ROOT_BITS
+    uint8_t bits; // total bits of the decoded codes
+};
+
+// root table plus one subtable for each of at most 255 distinct prefixes, see buildDecodeTable()
+const int MAX_DECODE_ENTRIES = (1 << ROOT_BITS) + (NUM_CHARS - 1) * (1 << SUB_BITS);
+
+
+/**
+ * All the decode tables of a Huffman code in one contiguous block: the root
+ * table followed by its subtables, and the multi-symbol table.
+ * It's sized for the worst case, so building the tables never allocates and
+ * one block is reused for every code.
+ */
+struct DecodeTables {
+    DecodeEntry entries[MAX_DECODE_ENTRIES];
+    MultiEntry multi[1 << ROOT_BITS];
+    int size; // number of entries in use
+    int minLength; // shortest code length
+};
+
+
+/*************************************
+ * Below are decompression functions *
+ *************************************/
 
-    void writeByteHelper(byte x) {
-        // When buffer is empty, we can directly write a byte to file
-        if (n == 0) {
-            out.write(reinterpret_cast<const char*>(&x), sizeof(byte));
+/**
+ * Fill the table at offset for the codes in order[begin, end), which all
+ * share their first `consumed` bits (already used by the parent tables).
+ * A code with at most tableBits bits left fills every entry sharing its
+ * prefix, longer codes are grouped by their next tableBits bits and each group
+ * gets a subtable of its own appended to the end of table.
+ * NOTE: canonical codes are sorted by (length, char), which also sorts them
+ * as left-aligned bit strings, so every group is a contiguous range.
+ */
+void fillTable(DecodeTables &tables, size_t offset, int tableBits, int consumed,
+               const Codeword codes[NUM_CHARS], const int order[], int begin, int end) {
+    int i = begin;
+    while (i < end) {
+        const Codeword &cw = codes[order[i]];
+        int rest = cw.length - consumed;
+        if (rest <= tableBits) {
+            DecodeEntry leaf = { (uint16_t) order[i], (uint8_t) rest, 0 };
+            size_t first = (size_t) (cw.code & (((uint64_t) 1 << rest) - 1)) << (tableBits - rest);
+            size_t count = (size_t) 1 << (tableBits - rest);
+            for (size_t k = 0; k < count; k++)
+                tables.entries[offset + first + k] = leaf;
+            i++;
         }
-        // write one bit at a time to the buffer, from MSB to LSB
         else {
-            for (int i = 0; i < 8; i++) {
-                // NOTE: this works since byte pads 0 from left
-                bool bit = ((x >> (8 - i - 1)) & 1) == 1;
-                writeBitHelper(bit);
+            size_t prefix = (size_t) (cw.code >> (rest - tableBits)) & (((size_t) 1 << tableBits) - 1);
+            int j = i + 1;
+            while (j < end) {
+                const Codeword &next = codes[order[j]];
+                int nextRest = next.length - consumed;
+                if (((size_t) (next.code >> (nextRest - tableBits)) & (((size_t) 1 << tableBits) - 1)) != prefix) break;
+                j++;
             }
+
+            // the longest code of the group is the last one
+            int subBits = std::min(SUB_BITS, codes[order[j - 1]].length - consumed - tableBits);
+            size_t subOffset = tables.size;
+            tables.size += 1 << subBits;
+            tables.entries[offset + prefix] = { (uint16_t) subOffset, (uint8_t) tableBits, (uint8_t) subBits };
+            fillTable(tables, subOffset, subBits, consumed + tableBits, codes, order, i, j);
+            i = j;
         }
     }
+}
 
-    void clearBuffer() {
-        if (n == 0) return;
-
-        // write out bits in buffer, padding with 0 from right
-        if (n > 0) buffer <<= (8 - n);
-        out.write(reinterpret_cast<const char*>(&buffer), sizeof(byte));
+/**
+ * Build a 2^ROOT_BITS entry table that decodes any code of at most ROOT_BITS
+ * bits with one lookup, longer codes go through one subtable of SUB_BITS.
+ * Every subtable holds at least 2 codes of a distinct prefix (at most 255 of
+ * them), so offsets stay below MAX_DECODE_ENTRIES and fit in 16 bits.
+ */
+void buildDecodeTable(const uint8_t lengths[NUM_CHARS], DecodeTables &tables) {
+    Codeword codes[NUM_CHARS];
+    buildCanonicalCodes(lengths, codes);
+
+    // used chars in canonical order
+    int order[NUM_CHARS];
+    int used = 0;
+    for (int len = 1; len <= MAX_CODE_LENGTH; len++)
+        for (int c = 0; c < NUM_CHARS; c++)
+            if (lengths[c] == len) order[used++] = c;
+
+    tables.size = 1 << ROOT_BITS;
+    fillTable(tables, 0, ROOT_BITS, 0, codes, order, 0, used);
+}
 
-        n = 0;
-        buffer = 0;
+/**
+ * Build a 2^ROOT_BITS entry table where each entry holds all the complete
+ * codes (up to MAX_MULTI_CHARS) found in its ROOT_BITS bits, read greedily
+ * from the MSB with the single-symbol root table.
+ */
+void buildMultiTable(DecodeTables &tables) {
+    const size_t mask = ((size_t) 1 << ROOT_BITS) - 1;
+    for (size_t index = 0; index <= mask; index++) {
+        MultiEntry &m = tables.multi[index];
+        int used = 0;
+        m.count = 0;
+        while (m.count < MAX_MULTI_CHARS) {
+            // bits past the ones left in index are shifted in as 0, so only
+            // accept a code that fits entirely in the remaining bits
+            const DecodeEntry &e = tables.entries[(index << used) & mask];
+            if (e.subBits != 0 || e.bits > ROOT_BITS - used) break;
+            m.chars[m.count++] = (unsigned char) e.value;
+            used += e.bits;
+        }
+        m.bits = (uint8_t) used;
     }
+}
 
-public:
-    BinaryOut(ofstream &out) : out(out), n(0), buffer(0) {}
+// build all the decode tables for the code lengths
+void buildDecoder(const uint8_t lengths[NUM_CHARS], DecodeTables &tables) {
+    buildDecodeTable(lengths, tables);
+    buildMultiTable(tables);
+    tables.minLength = MAX_CODE_LENGTH;
+    for (int c = 0; c < NUM_CHARS; c++)
+        if (lengths[c] != 0) tables.minLength = std::min<int>(tables.minLength, lengths[c]);
+}
 
-    void writeBit(bit x) {
-        writeBitHelper(x);
+inline unsigned char decodeChar(BinaryIn &bits, const DecodeEntry table[]) {
+    DecodeEntry e = table[bits.peek(ROOT_BITS)];
+    while (e.subBits != 0) {
+        bits.consume(e.bits);
+        e = table[e.value + bits.peek(e.subBits)];
     }
+    bits.consume(e.bits);
+    return (unsigned char) e.value;
+}
 
-    void writeByte(byte x) {
-        writeByteHelper(x);
+// decodeChar() right after BinaryIn::refillUnchecked(), which leaves enough bits for any code
+inline unsigned char decodeCharUnchecked(BinaryIn &bits, const DecodeEntry table[]) {
+    DecodeEntry e = table[bits.peekUnchecked(ROOT_BITS)];
+    if (e.subBits != 0) {
+        bits.consume(e.bits);
+        e = table[e.value + bits.peekUnchecked(e.subBits)];
     }
+    bits.consume(e.bits);
+    return (unsigned char) e.value;
+}
 
-    void writeUnsignedInt(unsigned int x) {
-        // use unsigned to make sure >> pads in 0 from left
-        writeByteHelper((x >> 24) & 0xff); // MSB
-        writeByteHelper((x >> 16) & 0xff);
-        writeByteHelper((x >> 8) & 0xff);
-        writeByteHelper((x >> 0) & 0xff); // LSB
-    }
+const uint64_t MIN_BULK_STEPS = 64; // don't bother with the bulk loop for fewer steps
 
-    void close() {
-        clearBuffer();
-    }
-};
+// number of bulk steps that fit in both the input left and dst[i, end)
+inline uint64_t bulkSteps(const BinaryIn &bits, size_t i, size_t end) {
+    // each step consumes at most MAX_CODE_LENGTH bits and writes at most MAX_MULTI_CHARS chars
+    return std::min<uint64_t>(bits.bitsBeforeTail() / MAX_CODE_LENGTH, (end - i) / MAX_MULTI_CHARS);
+}
 
+/**
+ * Decode up to MAX_MULTI_CHARS chars with one peek and one lookup to dst[i],
+ * codes longer than ROOT_BITS fall back to the single-symbol table and subtables.
+ */
+inline void decodeStep(BinaryIn &bits, const DecodeTables &tables, unsigned char *dst, size_t &i) {
+    bits.refillUnchecked();
+    const MultiEntry &m = tables.multi[bits.peekUnchecked(ROOT_BITS)];
+    if (m.count != 0) {
+        // always copy all the chars, only the first m.count are kept
+        std::memcpy(dst + i, m.chars, MAX_MULTI_CHARS);
+        i += m.count;
+        bits.consume(m.bits);
+    }
+    else {
+        dst[i++] = decodeCharUnchecked(bits, tables.entries);
+    }
+}
 
 /**
- * Utility class for reading bits from ifstream.
- * Basically it reads 8 bits from ifstream and fills up the buffer
+ * Decode chars to dst[i, end) while the input is far from its end and
+ * return the index of the next char to decode.
+ * The loop runs a number of steps computed up front that can't read past the
+ * input nor write past dst, so it has no EOF checks at all.
  */
-class BinaryIn {
-    using byte = unsigned char;
-    using bit = bool;
+inline size_t decodeBulk(BinaryIn &bits, const DecodeTables &tables, unsigned char *dst, size_t i, size_t end) {
+    while (true) {
+        uint64_t steps = bulkSteps(bits, i, end);
+        if (steps < MIN_BULK_STEPS) return i;
+        for (; steps > 0; steps--)
+            decodeStep(bits, tables, dst, i);
+    }
+}
 
-private:
-    byte buffer;
-    int n;
-    ifstream &in;
+static_assert(NUM_STREAMS == 4, "decodeBulk4() interleaves exactly 4 streams");
 
-    // returns true if input stream is used up
-    bool isEmpty() {
-        return in.eof();
+/**
+ * decodeBulk() on the 4 streams of a block at once, stream s decodes to
+ * dst[i[s], end[s]).
+ * One step of each stream per iteration: the streams don't depend on each
+ * other, so the CPU overlaps their table lookups instead of waiting for each
+ * code length in turn.
+ */
+inline void decodeBulk4(BinaryIn bits[NUM_STREAMS], const DecodeTables &tables, unsigned char *dst,
+                        size_t i[NUM_STREAMS], const size_t end[NUM_STREAMS]) {
+    // local copies, s.t. the readers can stay in registers
+    BinaryIn bits0 = bits[0], bits1 = bits[1], bits2 = bits[2], bits3 = bits[3];
+    size_t i0 = i[0], i1 = i[1], i2 = i[2], i3 = i[3];
+    while (true) {
+        uint64_t steps = std::min(std::min(bulkSteps(bits0, i0, end[0]), bulkSteps(bits1, i1, end[1])),
+                                  std::min(bulkSteps(bits2, i2, end[2]), bulkSteps(bits3, i3, end[3])));
+        if (steps < MIN_BULK_STEPS) break;
+        for (; steps > 0; steps--) {
+            decodeStep(bits0, tables, dst, i0);
+            decodeStep(bits1, tables, dst, i1);
+            decodeStep(bits2, tables, dst, i2);
+            decodeStep(bits3, tables, dst, i3);
+        }
     }
+    bits[0] = bits0, bits[1] = bits1, bits[2] = bits2, bits[3] = bits3;
+    i[0] = i0, i[1] = i1, i[2] = i2, i[3] = i3;
+}
 
-    void fillBuffer() {
-        if (isEmpty()) {
-            buffer = 0;
-            n = -1;
+/**
+ * Decode chars to dst[i, end).
+ * The checked loops only handle the last few bytes left by decodeBulk().
+ */
+void decodeChars(BinaryIn &in, const DecodeTables &tables, unsigned char *dst, size_t i, size_t end) {
+    const DecodeEntry *table = tables.entries;
+    const MultiEntry *multi = tables.multi;
+
+    // NOTE: decode with a local copy of the reader, otherwise the compiler must
+    // assume the char stores may alias its bit container and reloads it every time
+    BinaryIn bits = in;
+    i = decodeBulk(bits, tables, dst, i, end);
+
+    // checked tail, close to the end of the input or the output
+    while (i + MAX_MULTI_CHARS <= end) {
+        const MultiEntry &m = multi[bits.peek(ROOT_BITS)];
+        if (m.count != 0) {
+            std::memcpy(dst + i, m.chars, MAX_MULTI_CHARS);
+            i += m.count;
+            bits.consume(m.bits);
         }
         else {
-            in.read(reinterpret_cast<char*>(&buffer), sizeof(byte));
-            n = 8;
+            dst[i++] = decodeChar(bits, table);
         }
     }
+    while (i < end)
+        dst[i++] = decodeChar(bits, table);
+    if (bits.overrun()) throw runtime_error("File reached EOF already!");
+    in = bits;
+}
 
-public:
-    BinaryIn(ifstream &in) : in(in), n(0), buffer(0) {
-        fillBuffer();
+// decode the streams of a block of size chars to dst with tables, in is at the stream sizes
+void decodeStreams(BinaryIn &in, const DecodeTables &tables, unsigned char *dst, size_t size) {
+    int streams = blockStreams(size);
+    size_t streamBytes[NUM_STREAMS];
+    for (int s = 0; s < streams - 1; s++)
+        streamBytes[s] = (size_t) in.readBits(STREAM_SIZE_BITS);
+    in.alignToByte();
+    if (in.overrun()) throw runtime_error("File reached EOF already!");
+
+    // the last stream takes the rest of the input
+    size_t left = (size_t) (in.bitsLeft() / 8);
+    for (int s = 0; s < streams - 1; s++) {
+        if (streamBytes[s] > left) throw runtime_error("File reached EOF already!");
+        left -= streamBytes[s];
+    }
+    streamBytes[streams - 1] = left;
+
+    // Every char takes at least the shortest code length, so check once that
+    // each stream is long enough before decoding anything
+    BinaryIn bits[NUM_STREAMS];
+    size_t i[NUM_STREAMS], end[NUM_STREAMS];
+    size_t segment = streamLength(size, streams);
+    const unsigned char *p = in.position();
+    for (int s = 0; s < streams; s++) {
+        bits[s] = BinaryIn(p, streamBytes[s]);
+        p += streamBytes[s];
+        i[s] = std::min(size, s * segment);
+        end[s] = std::min(size, (s + 1) * segment);
+        if ((uint64_t) (end[s] - i[s]) * tables.minLength > (uint64_t) streamBytes[s] * 8)
+            throw runtime_error("File reached EOF already!");
     }
 
-    // read 1 bit and return a bool (NOTE it's not 1 byte bool)
-    bool readOneBitBool() {
-        if (isEmpty()) throw runtime_error("File reached EOF already!");
+    if (streams == NUM_STREAMS)
+        decodeBulk4(bits, tables, dst, i, end);
+    for (int s = 0; s < streams; s++)
+        decodeChars(bits[s], tables, dst, i[s], end[s]);
 
-        n--;
-        bool x = ((buffer >> n) & 1) == 1;
-        if (n == 0) fillBuffer();
-        return x;
-    }
+    // continue after the last stream
+    in = bits[streams - 1];
+    in.alignToByte();
+}
 
-    // read 1 byte and return a char
-    char readChar() {
-        if (isEmpty()) throw runtime_error("File reached EOF already!");
+/** Decode tables shared by the blocks of a file */
+struct DecodeContext {
+    DecodeTables *tables; // rebuilt for the code of every HUFFMAN_BLOCK
+    bool hasTables; // false until the first HUFFMAN_BLOCK
+    const DecodeTables *staticTables; // the static table of the file, if any
+};
 
-        // When there's exactly 1 byte in buffer, just return all bits in buffer
-        if (n == 8) {
-            char x = buffer;
-            fillBuffer();
-            return x;
-        }
-        // combine K bits in current buffer with first 8 - K bits in new buffer
-        else {
-            byte x = buffer;
-            int oldN = n;
-            x <<= (8 - n); // record first K bits
+// decode a Huffman block of size chars to dst, the tables are rebuilt for its code
+void decompressHuffmanBlock(BinaryIn &in, DecodeContext &context, unsigned char *dst, size_t size) {
+    // read code lengths from input and construct the decode tables
+    uint8_t lengths[NUM_CHARS];
+    readCodeLengths(in, lengths);
+    buildDecoder(lengths, *context.tables);
+    context.hasTables = true;
+    decodeStreams(in, *context.tables, dst, size);
+}
+
+// decode a block coded with the code of the last Huffman block, whose tables are still there
+void decompressRepeatBlock(BinaryIn &in, DecodeContext &context, unsigned char *dst, size_t size) {
+    if (!context.hasTables) throw runtime_error("Invalid block type!");
+    decodeStreams(in, *context.tables, dst, size);
+}
 
-            fillBuffer();
-            if (isEmpty()) throw runtime_error("File reached EOF already!");
+// decode a block coded with the static table of the file
+void decompressStaticBlock(BinaryIn &in, DecodeContext &context, unsigned char *dst, size_t size) {
+    if (context.staticTables == nullptr) throw runtime_error("Invalid block type!");
+    decodeStreams(in, *context.staticTables, dst, size);
+}
 
-            n = oldN;
-            x |= (buffer >> n); // record 8 - K bits from new buffer
-            return (char) x;
-        }
-    }
+// copy a stored block of size bytes to dst
+void decompressStoredBlock(BinaryIn &in, DecodeContext &, unsigned char *dst, size_t size) {
+    size_t left = (size_t) (in.bitsLeft() / 8);
+    if (size > left) throw runtime_error("File reached EOF already!");
+    const unsigned char *p = in.position();
+    std::memcpy(dst, p, size);
+    in = BinaryIn(p + size, left - size);
+}
 
-    // read 4 bytes and return an int
-    int readInt() {
-        int x = 0;
-        for (int i = 0; i < 4; i++) {
-            char c = readChar();
-            x <<= 8;
-            x |= (c & 0xff); // to avoid padding left with 1 when char is promoted to int implicitly!!!
-        }
-        return x;
+// expand the runs of an RLE block of size bytes to dst
+void decompressRLEBlock(BinaryIn &in, DecodeContext &, unsigned char *dst, size_t size) {
+    for (size_t i = 0; i < size; ) {
+        unsigned char c = (unsigned char) in.readBits(8);
+        uint64_t run = readVarint(in);
+        if (run == 0 || run > size - i) throw runtime_error("Invalid run length!");
+        std::memset(dst + i, c, (size_t) run);
+        i += (size_t) run;
     }
-};
+    if (in.overrun()) throw runtime_error("File reached EOF already!");
+}
 
+// decodes a block of size chars to dst with the codec of its block type
+typedef void (*BlockDecoder)(BinaryIn &in, DecodeContext &context, unsigned char *dst, size_t size);
 
-/** Node class for the Trie */
-class Node {
-public:
-    char ch; // NOTE: char range is -128 ~ 127
-    int freq;
-    Node* left;
-    Node* right;
+// codecs by block type, see Frame.h
+const BlockDecoder BLOCK_DECODERS[NUM_BLOCK_TYPES] = {
+    decompressHuffmanBlock, // HUFFMAN_BLOCK
+    decompressStoredBlock, // STORED_BLOCK
+    decompressRLEBlock, // RLE_BLOCK
+    decompressStaticBlock, // STATIC_BLOCK
+    decompressRepeatBlock, // REPEAT_BLOCK
+};
 
-    Node(char ch, int freq, Node* left, Node* right) :
-        ch(ch), freq(freq), left(left), right(right) {}
+/**
+ * Build the tables for the code of the HUFFMAN_BLOCK at data, without
+ * decoding the block, for the REPEAT_BLOCKs after it.
+ */
+void loadBlockCode(const unsigned char *data, size_t size, DecodeContext &context) {
+    BinaryIn in(data, size);
+    in.readUnsignedInt();
+    in.readBits(BLOCK_TYPE_BITS);
+    readVarint(in);
+    uint8_t lengths[NUM_CHARS];
+    readCodeLengths(in, lengths);
+    if (in.overrun()) throw runtime_error("File reached EOF already!");
+    buildDecoder(lengths, *context.tables);
+    context.hasTables = true;
+}
 
-    bool isLeaf() {
-        return (left == nullptr) && (right == nullptr);
+// decode one block of at most maxLength chars to dst and return its length
+size_t decompressBlock(BinaryIn &in, DecodeContext &context, unsigned char *dst, size_t maxLength) {
+    uint32_t checksum = in.readUnsignedInt();
+    int type = (int) in.readBits(BLOCK_TYPE_BITS);
+    uint64_t length = readVarint(in);
+    if (in.overrun()) throw runtime_error("File reached EOF already!");
+    if (type >= NUM_BLOCK_TYPES) throw runtime_error("Invalid block type!");
+    if (length == 0 || length > maxLength) throw runtime_error("Invalid block length!");
+    size_t size = (size_t) length;
+    BLOCK_DECODERS[type](in, context, dst, size);
+
+    // verify the block while it's still in cache
+    if (crc32c(dst, size) != checksum) throw runtime_error("Checksum mismatch!");
+    return size;
+}
+
+/**
+ * Write bytes [begin, end) of the original file to file, in must be at the
+ * start of the block at blockBegin, which is at or before the one holding begin.
+ * model is the static table the file was compressed with, if any, and
+ * codeBlock the HUFFMAN_BLOCK whose code the first blocks repeat, if any.
+ * Each block is decoded to a buffer that is reused for the next one, so it's
+ * still in cache when it's written out and memory use doesn't grow with the
+ * output.
+ */
+void decodeRange(BinaryIn &in, const FrameHeader &header, const StaticTable *model, size_t blockBegin,
+                 const unsigned char *codeBlock, size_t begin, size_t end, InputFile &input, OutputFile &file) {
+    std::unique_ptr<DecodeTables> staticTables;
+    if (header.flags & FRAME_STATIC_TABLE) {
+        if (model == nullptr) throw runtime_error("Model file required!");
+        if (model->id != header.tableId) throw runtime_error("Model doesn't match the file!");
+        staticTables.reset(new DecodeTables());
+        buildDecoder(model->lengths, *staticTables);
     }
-};
 
+    if (begin == end) return;
+    std::unique_ptr<DecodeTables> tables(new DecodeTables());
+    DecodeContext context = { tables.get(), false, staticTables.get() };
+    if (codeBlock != nullptr) loadBlockCode(codeBlock, input.data() + input.size() - codeBlock, context);
+    std::vector<unsigned char> buffer(header.blockSize);
+    while (blockBegin < end) {
+        size_t maxLength = std::min(header.blockSize, header.size - blockBegin);
+        size_t length = decompressBlock(in, context, buffer.data(), maxLength);
+
+        size_t from = std::max(begin, blockBegin);
+        size_t to = std::min(end, blockBegin + length);
+        if (from < to) file.write(buffer.data() + (from - blockBegin), to - from);
+        input.release(in.position());
+        blockBegin += length;
+    }
+}
 
-/*************************************
- * Below are decompression functions *
- *************************************/
+void decompress(InputFile &input, OutputFile &file, const StaticTable *model) {
+    BinaryIn in(input.data(), input.size());
+    FrameHeader header = readFrameHeader(in);
+    decodeRange(in, header, model, 0, nullptr, 0, header.size, input, file);
+    file.close();
+}
 
-Node* readTrie(BinaryIn &in) {
-    bool isLeaf = in.readOneBitBool();
-    if (isLeaf)
-        return new Node(in.readChar(), -1, nullptr, nullptr); // -1 is just dummy value for freq
-    else
-        return new Node(0, -1, readTrie(in), readTrie(in));
-}
-
-void decompress(BinaryIn &in, BinaryOut &out) {
-    // read from input and construct Trie
-    Node* root = readTrie(in);
-
-    // get number of bytes of the uncompressed file
-    int length = in.readInt();
-
-    // Write decoded binary to output
-    for (int i = 0; i < length; i++) {
-        Node* n = root;
-        // Traverse to decoded char corresponding to code
-        while (!n->isLeaf()) {
-            bool isRightChild = in.readOneBitBool();
-            if (isRightChild)
-                n = n->right;
-            else
-                n = n->left;
+/**
+ * Decompress only bytes [begin, end) of the original file.
+ * With a seek index, decoding starts right at the block holding begin, so the
+ * time is proportional to the range, otherwise every block before it is
+ * decoded and thrown away.
+ * NOTE: a REPEAT_BLOCK needs the code of an earlier block, so if one comes
+ * before any HUFFMAN_BLOCK in the range, the code of the last HUFFMAN_BLOCK
+ * before the range is loaded first. Block types are read straight from the
+ * file at the offsets of the index.
+ */
+void decompressRange(InputFile &input, OutputFile &file, const StaticTable *model, size_t begin, size_t end) {
+    const unsigned char *data = input.data();
+    size_t size = input.size();
+    BinaryIn in(data, size);
+    FrameHeader header = readFrameHeader(in);
+    if (begin > end || end > header.size) throw runtime_error("Invalid range!");
+
+    size_t blockBegin = 0;
+    const unsigned char *codeBlock = nullptr;
+    if (header.flags & FRAME_SEEK_INDEX && begin < end) {
+        size_t blocksBegin = (size_t) (in.position() - data);
+        std::vector<SeekEntry> index = readSeekIndex(data, size, blocksBegin, header);
+        auto after = std::upper_bound(index.begin(), index.end(), begin,
+                                      [](size_t offset, const SeekEntry &e) { return offset < e.offset; });
+        size_t first = (size_t) (after - index.begin()) - 1;
+
+        auto blockType = [&](size_t b) { return data[index[b].compressedOffset + CHECKSUM_BITS / 8]; };
+        size_t b = first;
+        while (b < index.size() && index[b].offset < end && blockType(b) != HUFFMAN_BLOCK &&
+               blockType(b) != REPEAT_BLOCK)
+            b++;
+        if (b < index.size() && index[b].offset < end && blockType(b) == REPEAT_BLOCK) {
+            for (b = first; b > 0 && blockType(b - 1) != HUFFMAN_BLOCK; b--) {}
+            if (b > 0) codeBlock = data + index[b - 1].compressedOffset;
         }
-        out.writeByte(n->ch);
+
+        size_t offset = index[first].compressedOffset;
+        in = BinaryIn(data + offset, size - offset);
+        blockBegin = index[first].offset;
     }
-    out.close();
+    decodeRange(in, header, model, blockBegin, codeBlock, begin, end, input, file);
+    file.close();
 }
 
 int main(int argc, char **argv)
 {
+    // optional "-r begin end" before the file name, to decompress only bytes [begin, end),
+    // and "-m model.bin" for files compressed with a static table
+    bool range = false;
+    size_t begin = 0, end = 0;
+    string modelPath;
+    while (argc >= 3) {
+        string option = argv[1];
+        if (argc >= 5 && option == "-r") {
+            range = true;
+            begin = (size_t) std::strtoull(argv[2], nullptr, 10);
+            end = (size_t) std::strtoull(argv[3], nullptr, 10);
+            argv += 3;
+            argc -= 3;
+        }
+        else if (argc >= 4 && option == "-m") {
+            modelPath = argv[2];
+            argv += 2;
+            argc -= 2;
+        }
+        else {
+            break;
+        }
+    }
     if (argc != 2) {
-        cout << "Usage: decompress.exe filenameCompressed.bin" << endl;
+        cout << "Usage: decompress.exe [-r begin end] [-m model.bin] filenameCompressed.bin" << endl;
         return 1;
     }
 
+    StaticTable table;
+    if (!modelPath.empty()) {
+        InputFile model(modelPath);
+        if (!model) {
+            cout << "Failed to open file." << endl;
+            return 1;
+        }
+        loadStaticTable(model, table);
+    }
+    const StaticTable *model = modelPath.empty() ? nullptr : &table;
+
     // open the files
     string inputPath = argv[1];
-    ifstream iFile(inputPath, ios::binary);
-    BinaryIn in(iFile);
+    InputFile iFile(inputPath);
 
     string removeExtension = inputPath.substr(0, inputPath.length() - 14);
-    ofstream oFile(removeExtension + "Decompressed.bin", ios::binary);
-    BinaryOut out(oFile);
+    OutputFile oFile(removeExtension + "Decompressed.bin");
 
     if (iFile && oFile) {
-        decompress(in, out);
+        if (range)
+            decompressRange(iFile, oFile, model, begin, end);
+        else
+            decompress(iFile, oFile, model);
     } else {
         cout << "Failed to open file." << endl;
         return 1;
     }
+
+    return 0;
 }
@@ -0,0 +1,132 @@
+/**
+ * Benchmark of the Huffman decode loop of decompress.cpp, in chars per cycle.
+ * Every HUFFMAN_BLOCK and REPEAT_BLOCK of a compressed file is decoded
+ * BENCH_RUNS times from memory and the best run of each block is summed.
+ * Building the tables, the checksum and the output file are left out.
+ * The multi-symbol table is compared with single-symbol decoding, which is
+ * the same loop with every multi-symbol entry marked as a fallback.
+ *
+ * decompress.cpp is included with its main() renamed, s.t. this measures
+ * the very code the tool runs.
+ *
+ * To compile this program on linux, use: g++ -std=c++11 -O2 -o decode decode.cpp
+ * Usage: ./decode fileCompressed.bin... (compressed without -m)
+ */
+
+#define main decompressMain
+#include "../Decompress/decompress.cpp"
+#undef main
+
+#include <chrono>
+#include <cstdio>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define BENCH_RDTSC
+#endif
+
+
+const int BENCH_RUNS = 7;
+
+// time stamp counter, 0 if there is none
+inline uint64_t cycles() {
+#ifdef BENCH_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct Timing {
+    uint64_t cycles;
+    double seconds;
+};
+
+/** Best of BENCH_RUNS decodes of the streams at in with tables, to dst */
+Timing timeStreams(const BinaryIn &in, const DecodeTables &tables, unsigned char *dst, size_t size) {
+    Timing best = { UINT64_MAX, 1e30 };
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        BinaryIn bits = in;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t startCycles = cycles();
+        decodeStreams(bits, tables, dst, size);
+        uint64_t used = cycles() - startCycles;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best.cycles = std::min(best.cycles, used);
+        best.seconds = std::min(best.seconds, seconds);
+    }
+    return best;
+}
+
+void report(const char *name, size_t chars, const Timing &t) {
+    std::printf("  %-14s %.3f chars/cycle  %.2f GB/s\n", name, t.cycles ? (double) chars / t.cycles : 0.0,
+                chars / t.seconds / 1e9);
+}
+
+void bench(const InputFile &input) {
+    BinaryIn in(input.data(), input.size());
+    FrameHeader header = readFrameHeader(in);
+    if (header.flags & FRAME_STATIC_TABLE) throw runtime_error("Static tables are not supported!");
+
+    std::unique_ptr<DecodeTables> tables(new DecodeTables());
+    std::unique_ptr<DecodeTables> single(new DecodeTables());
+    DecodeContext context = { tables.get(), false, nullptr };
+    std::vector<unsigned char> buffer(header.blockSize);
+
+    size_t chars = 0;
+    Timing multiTime = { 0, 0 }, singleTime = { 0, 0 };
+    for (size_t offset = 0; offset < header.size; ) {
+        // decode the block once to move past it and build its tables
+        BinaryIn block = in;
+        size_t length = decompressBlock(in, context, buffer.data(), std::min(header.blockSize, header.size - offset));
+        offset += length;
+
+        block.readUnsignedInt();
+        int type = (int) block.readBits(BLOCK_TYPE_BITS);
+        readVarint(block);
+        if (type != HUFFMAN_BLOCK && type != REPEAT_BLOCK) continue;
+        if (type == HUFFMAN_BLOCK) {
+            uint8_t lengths[NUM_CHARS];
+            readCodeLengths(block, lengths);
+        }
+
+        *single = *tables;
+        for (MultiEntry &m : single->multi)
+            m.count = 0;
+
+        Timing multi = timeStreams(block, *tables, buffer.data(), length);
+        Timing one = timeStreams(block, *single, buffer.data(), length);
+        chars += length;
+        multiTime.cycles += multi.cycles;
+        multiTime.seconds += multi.seconds;
+        singleTime.cycles += one.cycles;
+        singleTime.seconds += one.seconds;
+    }
+
+    if (chars == 0) {
+        std::printf("  no Huffman blocks\n");
+        return;
+    }
+    std::printf("  %zu of %zu chars in Huffman blocks\n", chars, header.size);
+    report("single-symbol", chars, singleTime);
+    report("multi-symbol", chars, multiTime);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::printf("Usage: decode fileCompressed.bin...\n");
+        return 1;
+    }
+
+    for (int f = 1; f < argc; f++) {
+        InputFile file(argv[f]);
+        if (!file) {
+            std::printf("Failed to open file.\n");
+            return 1;
+        }
+        std::printf("%s\n", argv[f]);
+        bench(file);
+    }
+    return 0;
+}
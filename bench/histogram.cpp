@@ -0,0 +1,104 @@
+/**
+ * Microbenchmark of the byte counting kernels of Common/Histogram.h against
+ * the unordered_map pass compress.cpp used before them.
+ * Prints GB/s for each file, best of RUNS runs over the file in memory.
+ *
+ * To compile this program on linux, use: g++ -std=c++11 -O2 -o histogram histogram.cpp
+ * Usage: ./histogram file.bin...
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#include "../Common/Histogram.h"
+#include "../Common/InputFile.h"
+
+using std::unordered_map;
+
+
+const int RUNS = 5;
+
+// the map based pass of the original compress.cpp
+void countMap(const unsigned char *data, size_t size, uint64_t freq[256]) {
+    unordered_map<char, int> map;
+    for (size_t i = 0; i < size; i++)
+        map[(char) data[i]]++;
+    for (const auto &e : map)
+        freq[(unsigned char) e.first] += e.second;
+}
+
+// a single table of counters
+void countPlain(const unsigned char *data, size_t size, uint64_t freq[256]) {
+    for (size_t i = 0; i < size; i++)
+        freq[data[i]]++;
+}
+
+// countChars() with the kernel picked by the caller
+template <class Kernel>
+void countTables(const unsigned char *data, size_t size, uint64_t freq[256], Kernel kernel) {
+    uint32_t counts[HISTOGRAM_TABLES][256] = {};
+    kernel(data, size, counts);
+    for (int c = 0; c < 256; c++)
+        for (int t = 0; t < HISTOGRAM_TABLES; t++)
+            freq[c] += counts[t][c];
+}
+
+/** Best GB/s of count() over RUNS runs, which must give the counts in expected */
+template <class Count>
+double measure(const unsigned char *data, size_t size, const uint64_t expected[256], Count count) {
+    double best = 1e30;
+    for (int r = 0; r < RUNS; r++) {
+        uint64_t freq[256] = {};
+        auto start = std::chrono::steady_clock::now();
+        count(data, size, freq);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (std::memcmp(freq, expected, sizeof(freq)) != 0) {
+            std::printf("wrong counts!\n");
+            return 0;
+        }
+        best = std::min(best, seconds);
+    }
+    return size / best / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::printf("Usage: histogram file.bin...\n");
+        return 1;
+    }
+
+    std::printf("%-24s %8s %8s %8s %8s  (GB/s)\n", "file", "map", "plain", "4 tables", "AVX2");
+    for (int f = 1; f < argc; f++) {
+        InputFile file(argv[f]);
+        if (!file) {
+            std::printf("Failed to open file.\n");
+            return 1;
+        }
+        const unsigned char *data = file.data();
+        size_t size = file.size();
+
+        // also faults in the pages of the file before any timing
+        uint64_t expected[256] = {};
+        countPlain(data, size, expected);
+
+        double map = measure(data, size, expected, countMap);
+        double plain = measure(data, size, expected, countPlain);
+        double tables = measure(data, size, expected, [](const unsigned char *d, size_t n, uint64_t freq[256]) {
+            countTables(d, n, freq, countCharsPortable);
+        });
+        double avx2 = 0;
+#ifdef HISTOGRAM_AVX2
+        if (hasAVX2())
+            avx2 = measure(data, size, expected, [](const unsigned char *d, size_t n, uint64_t freq[256]) {
+                countTables(d, n, freq, countCharsAVX2);
+            });
+#endif
+        std::printf("%-24s %8.2f %8.2f %8.2f %8.2f\n", argv[f], map, plain, tables, avx2);
+    }
+    return 0;
+}